@@ -114,6 +114,11 @@ Java_com_redttg_matrix_MatrixWallpaperService_nativeInit(
         new_renderer->initializePP();
         LOGI("Post-processing initialized");
 
+        if (new_renderer->opts->qualityGovernor) {
+            new_renderer->governor = new QualityGovernor();
+            new_renderer->governor->initialize(new_renderer->opts->swapTime);
+        }
+
         LOGI("Renderer fully initialized successfully");
 
         // Only now assign to global pointer (lock for assignment only)
@@ -0,0 +1,10 @@
+#version 300 es
+precision mediump float;
+// Paired with transform feedback programs, nothing is ever rasterized
+
+out vec4 fragColor;
+
+void main()
+{
+    discard;
+}
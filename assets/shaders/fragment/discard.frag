@@ -0,0 +1,9 @@
+#version 330 core
+// Paired with transform feedback programs, nothing is ever rasterized
+
+out vec4 fragColor;
+
+void main()
+{
+    discard;
+}
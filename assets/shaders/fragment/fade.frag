@@ -0,0 +1,9 @@
+#version 330 core
+// Drawn with blend factors that only scale what is already in the framebuffer, the color itself is never used
+
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(0.0);
+}
@@ -1,12 +1,26 @@
 #version 330 core
 out vec4 fragColor;
 
-uniform sampler2D u_AtlasTexture;
+uniform sampler2DArray u_AtlasTexture;
 uniform float u_BaseColor;
+uniform int u_DistanceField;
+uniform float u_SparkBrightness;  // Past 1 with the bloom, the scene holds half floats then
 
 in float v_ColorOffset;
 flat in int v_Spark;
-in vec2 v_TexCoord;
+in vec3 v_TexCoord;
+in float v_TrailAlpha;
+
+// The atlas holds coverage, or with u_DistanceField the distance to the glyph edge at 0.5
+float glyphCoverage() {
+    float glyph = texture(u_AtlasTexture, v_TexCoord).r;
+    // Half a screen pixel either side of the edge, taken outside the branch so the derivative is defined
+    float edgeWidth = 0.5 * fwidth(glyph);
+    if (u_DistanceField == 0) {
+        return glyph;
+    }
+    return smoothstep(0.5 - edgeWidth, 0.5 + edgeWidth, glyph);
+}
 
 vec3 hueToRgb(float hue) {
     float r = abs(hue * 6.0 - 3.0) - 1.0;
@@ -17,16 +31,20 @@ vec3 hueToRgb(float hue) {
 
 void main()
 {
-    float glyphColor = texture(u_AtlasTexture, v_TexCoord).r;
+    float glyphColor = glyphCoverage();
 
     vec3 color;
 
     if (v_Spark == 0) {
-        color = vec3(1.0, 1.0, 1.0);
+        // Only the raindrop itself goes past white, the glyphs it leaves behind fade from white
+        color = vec3(v_TrailAlpha > 0.999 ? u_SparkBrightness : 1.0);
     } else {
         float hue = mod(u_BaseColor + v_ColorOffset, 1.0);
         color = hueToRgb(hue);
     }
 
-    fragColor = vec4(color * glyphColor, glyphColor);
+    // The ghosting multiplies by alpha every frame, so the distance field edge is only faded in the color,
+    // a glyph pixel keeps full alpha from the outer half of the edge on and fades as long as a hard one
+    float glyphAlpha = u_DistanceField == 0 ? glyphColor : min(glyphColor * 2.0, 1.0);
+    fragColor = vec4(color * glyphColor, glyphAlpha) * v_TrailAlpha;
 }
\ No newline at end of file
@@ -1,20 +1,36 @@
 #version 330 core
 out vec4 fragColor;
 
-uniform sampler2D u_AtlasTexture;
+uniform sampler2DArray u_AtlasTexture;
 uniform sampler2D u_WallpaperTexture;
 uniform float u_BaseColor;
+uniform int u_DistanceField;
 
 in float v_ColorOffset;
 flat in int v_Spark;
-in vec2 v_TexCoord;
+in vec3 v_TexCoord;
+in float v_TrailAlpha;
 in vec2 v_ScreenCoord;
 
+// The atlas holds coverage, or with u_DistanceField the distance to the glyph edge at 0.5
+float glyphCoverage() {
+    float glyph = texture(u_AtlasTexture, v_TexCoord).r;
+    // Half a screen pixel either side of the edge, taken outside the branch so the derivative is defined
+    float edgeWidth = 0.5 * fwidth(glyph);
+    if (u_DistanceField == 0) {
+        return glyph;
+    }
+    return smoothstep(0.5 - edgeWidth, 0.5 + edgeWidth, glyph);
+}
+
 void main()
 {
-    float glyphColor = texture(u_AtlasTexture, v_TexCoord).r;
+    float glyphColor = glyphCoverage();
 
     vec3 wallpaperColor = texture(u_WallpaperTexture, v_ScreenCoord).rgb;
 
-    fragColor = vec4(wallpaperColor * glyphColor, glyphColor);
+    // The ghosting multiplies by alpha every frame, so the distance field edge is only faded in the color,
+    // a glyph pixel keeps full alpha from the outer half of the edge on and fades as long as a hard one
+    float glyphAlpha = u_DistanceField == 0 ? glyphColor : min(glyphColor * 2.0, 1.0);
+    fragColor = vec4(wallpaperColor * glyphColor, glyphAlpha) * v_TrailAlpha;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#version 330 core
+
+// Every post-processing stage, the renderer compiles a variant with POST_GHOSTING and POST_BLUR
+// defined for each combination of stages it fuses into one pass. Wide blurs run as a dual filter
+// pyramid instead, POST_DOWNSAMPLE halves the frame and POST_UPSAMPLE doubles it back. The bloom
+// pyramid starts with POST_BRIGHT_PASS, POST_BLOOM adds it on top in the pass that draws to the window
+uniform sampler2D u_textureC;
+uniform sampler2D u_textureP;
+uniform float u_previousFrameOpacity;
+uniform float u_blurSize;
+uniform sampler2D u_textureBloom;
+uniform float u_bloomStrength;
+in vec2 v_texcoord;
+out vec4 fragColor;
+
+// The frame at uv after the stages that only look at their own pixel
+vec4 stage(vec2 uv) {
+    vec4 currentFrame = texture(u_textureC, uv);
+#ifdef POST_GHOSTING
+    vec4 previousFrame = texture(u_textureP, uv);
+
+    vec4 blendedFrame = mix(previousFrame * u_previousFrameOpacity, currentFrame, currentFrame.a);
+
+    // Proper alpha blending
+    float alpha = currentFrame.a + (1.0 - currentFrame.a) * previousFrame.a * u_previousFrameOpacity;
+    return clamp(vec4(blendedFrame.rgb * alpha, alpha), 0.0, 1.0);
+#elif defined(POST_BRIGHT_PASS)
+    // Only what is brighter than white blooms
+    float brightness = max(currentFrame.r, max(currentFrame.g, currentFrame.b));
+    return currentFrame * (max(brightness - 1.0, 0.0) / max(brightness, 0.0001));
+#else
+    return currentFrame;
+#endif
+}
+
+void main() {
+#if defined(POST_DOWNSAMPLE)
+    vec2 texOffset = u_blurSize / vec2(textureSize(u_textureC, 0));
+
+    // The centre and four diagonal taps between texels, bilinear filtering averages 16 texels in 5 reads
+    vec4 color = stage(v_texcoord) * 4.0;
+    color += stage(v_texcoord + texOffset * vec2(-1.0, -1.0));
+    color += stage(v_texcoord + texOffset * vec2(1.0, -1.0));
+    color += stage(v_texcoord + texOffset * vec2(-1.0, 1.0));
+    color += stage(v_texcoord + texOffset * vec2(1.0, 1.0));
+
+    fragColor = color / 8.0;
+#elif defined(POST_UPSAMPLE)
+    vec2 texOffset = u_blurSize / vec2(textureSize(u_textureC, 0));
+
+    // A tent over the smaller level, the diagonal taps weigh twice as much as the ones on the axes
+    vec4 color = stage(v_texcoord + texOffset * vec2(-1.0, 0.0));
+    color += stage(v_texcoord + texOffset * vec2(1.0, 0.0));
+    color += stage(v_texcoord + texOffset * vec2(0.0, -1.0));
+    color += stage(v_texcoord + texOffset * vec2(0.0, 1.0));
+    color += stage(v_texcoord + texOffset * vec2(-0.5, -0.5)) * 2.0;
+    color += stage(v_texcoord + texOffset * vec2(0.5, -0.5)) * 2.0;
+    color += stage(v_texcoord + texOffset * vec2(-0.5, 0.5)) * 2.0;
+    color += stage(v_texcoord + texOffset * vec2(0.5, 0.5)) * 2.0;
+
+    fragColor = color / 12.0;
+#elif defined(POST_BLUR)
+    vec2 texOffset = u_blurSize / vec2(textureSize(u_textureC, 0));  // Calculate offset based on texture size
+    vec4 color = vec4(0.0);
+
+    // A box blur over the neighbouring pixels, the earlier stages run at every tap instead of being read from a target
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            color += stage(v_texcoord + texOffset * vec2(x, y));
+        }
+    }
+
+    fragColor = color / 9.0;  // Average the colors
+#else
+    fragColor = stage(v_texcoord);
+#endif
+#ifdef POST_BLOOM
+    fragColor += texture(u_textureBloom, v_texcoord) * u_bloomStrength;
+#endif
+}
@@ -1,17 +1,15 @@
 #version 330 core
-struct CharacterInfo {
-    uint xOffset;
-    uint yOffset;
-    uint width;
-    uint height;
-};
-
 layout(location = 0) in vec2 position;
 layout(location = 1) in float colorOffset;
 layout(location = 2) in int spark;
-layout(std140) uniform u_AtlasBuffer {
-    CharacterInfo characterInfoList[64];
-};
+layout(location = 4) in float velocityX;
+layout(location = 5) in float velocityY;
+layout(location = 6) in vec2 history;
+layout(location = 7) in float startTime;   // Analytic rain only, seconds since the motion epoch
+layout(location = 8) in vec2 positionFraction;  // Packed instances only, parts of a fixed point step
+// Every glyph of the charset as xOffset | yOffset << 16, width | height << 16 and its layer of the atlas,
+// GLYPH_TABLE_WIDTH glyphs a row
+uniform usampler2D u_GlyphTable;
 
 uniform mat4 u_Projection;
 uniform vec2 u_ViewportSize;
@@ -20,29 +18,62 @@ uniform int u_MaxCharacters;
 uniform float u_CharacterScaling;
 uniform float u_Time;
 uniform int u_Rotation;
+uniform float u_TickAlpha;
+// 1 for float instances, the fixed point steps of packed ones
+uniform float u_PositionScale;
+uniform float u_VelocityScale;
+// Trail pass only, u_TrailSlots is 0 when the raindrops themselves are drawn
+uniform int u_TrailSlots;
+uniform int u_TrailDrops;
+uniform int u_TrailHead;
+uniform int u_TrailActive;
+uniform float u_TrailStamps[32];
+// Warm-up pass only, every instance is a past position of a raindrop faded as much as the ghosting would have by now
+uniform int u_History;
+// Analytic rain, every instance moves in a straight line from where it was at startTime, u_MotionTime is now
+uniform int u_Motion;
+uniform float u_MotionTime;
 
 out float v_ColorOffset;
 flat out int v_Spark;
-out vec2 v_TexCoord;
+out vec3 v_TexCoord;
 out vec2 v_ScreenCoord;
+out float v_TrailAlpha;
 
-int generateRandomIndex(int instanceID, int maxIndex) {
-    return abs(int(mod(floor(instanceID + u_Time * 100), float(maxIndex))));
+int generateRandomIndex(int instanceID, int maxIndex, float time) {
+    return abs(int(mod(floor(instanceID + time * 100), float(maxIndex))));
 }
 
 void main()
 {
     // Get a random index for the character data
-    int randomIndex = generateRandomIndex(gl_InstanceID+1, u_MaxCharacters);
+    int drop = gl_InstanceID;
+    float glyphTime = u_Time;
+    v_TrailAlpha = 1.0;
+    if (u_TrailSlots > 0) {
+        // Trail instances are laid out slot by slot, each slot keeps the glyphs shown on the tick it recorded
+        int slot = gl_InstanceID / u_TrailDrops;
+        int age = (u_TrailHead - slot + u_TrailSlots) % u_TrailSlots;
+        drop = gl_InstanceID - slot * u_TrailDrops;
+        glyphTime = u_TrailStamps[slot];
+        // The newest slot sits under the raindrop itself, unwritten slots have no stamp and sleeping raindrops leave no trail
+        float fade = (age == 0 || glyphTime < 0.0 || drop >= u_TrailActive) ? 0.0 : 1.0 - float(age) / float(u_TrailSlots);
+        v_TrailAlpha = fade * fade;
+    }
+    if (u_History != 0) {
+        glyphTime = u_Time - history.x;
+        v_TrailAlpha = history.y;
+    }
+    int randomIndex = generateRandomIndex(drop+1, u_MaxCharacters, glyphTime);
     //    int randomIndex = gl_InstanceID;
 
-    // Fetch the character data from the texture buffer using the random index
-    CharacterInfo characterInfo = characterInfoList[randomIndex];
+    // Fetch the character data from the glyph table using the random index
+    uvec4 glyph = texelFetch(u_GlyphTable, ivec2(randomIndex % 256, randomIndex / 256), 0);
 
-    float glyphXOffset = float(characterInfo.xOffset);
-    float glyphYOffset = float(characterInfo.yOffset);
-    float glyphWidth = float(characterInfo.width);
-    float glyphHeight = float(characterInfo.height);
+    float glyphXOffset = float(glyph.r & 0xFFFFu);
+    float glyphYOffset = float(glyph.r >> 16);
+    float glyphWidth = float(glyph.g & 0xFFFFu);
+    float glyphHeight = float(glyph.g >> 16);
 
     float angle = radians(float(u_Rotation));
     mat2 rotationMatrix = mat2(cos(angle), -sin(angle), sin(angle), cos(angle));
@@ -59,21 +90,33 @@ void main()
         vertexPosition = vec2(0.0, glyphHeight);
     }
 
+    // Step back from the latest tick towards the previous one
+    vec2 tickPosition = (position + positionFraction / 256.0) * u_PositionScale -
+        vec2(velocityX, velocityY) * u_VelocityScale * (1.0 - u_TickAlpha);
+    if (u_Motion != 0) {
+        // Trail slots are moved to the time they were recorded at
+        tickPosition = position + vec2(velocityX, velocityY) * (u_MotionTime + (glyphTime - u_Time) - startTime);
+    }
+
     // Add the vertex position in NDC
-    vec2 screenPosition = position + (vertexPosition * u_CharacterScaling);
+    vec2 screenPosition = tickPosition + (vertexPosition * u_CharacterScaling);
     v_ScreenCoord = vec2(1.0) - vec2(1.0 - (screenPosition.x / u_ViewportSize.x), screenPosition.y / u_ViewportSize.y);
     vec2 atlasPosition = vec2(glyphXOffset, glyphYOffset) + vertexPosition;
 
     // Calculate the center of the character
-    vec2 center = position + vec2(glyphWidth, glyphHeight) * 0.5 * u_CharacterScaling;
+    vec2 center = tickPosition + vec2(glyphWidth, glyphHeight) * 0.5 * u_CharacterScaling;
 
     // Translate to the center, apply rotation, and translate back
     screenPosition = rotationMatrix * (screenPosition - center) + center;
 
     // Apply the projection matrix to get the position in clip space
     gl_Position = u_Projection * vec4(screenPosition, 0.0, 1.0);
+    if (v_TrailAlpha == 0.0) {
+        // Collapse invisible trail glyphs so they are never rasterized
+        gl_Position = vec4(0.0);
+    }
 
     v_ColorOffset = colorOffset;
     v_Spark = spark;
-    v_TexCoord = vec2(atlasPosition.x, u_AtlasTextureSize.y - atlasPosition.y) / u_AtlasTextureSize;
+    v_TexCoord = vec3(vec2(atlasPosition.x, u_AtlasTextureSize.y - atlasPosition.y) / u_AtlasTextureSize, float(glyph.b));
 }
\ No newline at end of file
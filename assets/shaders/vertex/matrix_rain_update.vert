@@ -0,0 +1,134 @@
+#version 330 core
+// Advances one raindrop per vertex, the outputs are captured with transform feedback
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in float colorOffset;
+layout(location = 2) in int spark;
+layout(location = 3) in float speed;
+layout(location = 4) in vec2 push;
+layout(location = 5) in int pardons;
+
+uniform uvec2 u_Seed;
+uniform uint u_Frame;
+uniform vec2 u_Cursors[4]; // MATRIX_RAIN_MAX_CURSORS
+uniform int u_CursorCount;
+uniform float u_CursorRadius;
+uniform float u_SpeedBias;
+uniform float u_Fall;
+uniform float u_Jitter;
+uniform vec2 u_ScreenSize;
+uniform int u_FallUp;
+uniform int u_ChanceOfSpark;
+uniform float u_ColorVariation;
+
+out vec2 tf_Position;
+out float tf_ColorOffset;
+flat out int tf_Spark;
+out float tf_Speed;
+out vec2 tf_Push;
+flat out int tf_Pardons;
+out vec2 tf_Velocity;
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Counter-based like the CPU generator, a pure function of (seed, raindrop, frame, stream)
+uint random(uint stream) {
+    return hash(uint(gl_VertexID) ^ hash(u_Frame ^ hash(stream ^ hash(u_Seed.x ^ hash(u_Seed.y)))));
+}
+
+float randomUnit(uint stream) {
+    return float(random(stream) >> 8) * (1.0 / 16777216.0);
+}
+
+int randomRange(uint stream, int a, int b) {
+    return a + int(min(randomUnit(stream) * float(b - a + 1), float(b - a)));
+}
+
+float randomColumn(uint stream) {
+    return randomUnit(stream) * u_ScreenSize.x;
+}
+
+void main()
+{
+    vec2 p = position;
+    vec2 pushForce = push;
+    int pardonsLeft = pardons;
+    float colorShift = colorOffset;
+
+    vec2 start = p;
+    // The first cursor in reach pushes the raindrop away
+    bool pushed = false;
+    if (pardonsLeft == 0 && randomRange(0u, 0, 10) != 0) {
+        for (int i = 0; i < u_CursorCount && !pushed; ++i) {
+            vec2 d = p - u_Cursors[i];
+            float distance = length(d);
+            if (distance < u_CursorRadius) {
+                float force = (u_CursorRadius - distance) / u_CursorRadius;
+                vec2 cursorPush = d / distance * force * 100.0;
+                p += cursorPush;
+                pushForce += cursorPush;
+                pushed = true;
+            }
+        }
+    }
+
+    if (pardonsLeft > 0) {
+        // Expand from the cursor
+        p += pushForce;
+        pardonsLeft--;
+        if (pardonsLeft == 0) {
+            pushForce = vec2(0.0);
+        }
+    } else if (!pushed && pushForce != vec2(0.0)) {
+        // Reset the push force
+        p -= pushForce;
+        pushForce = vec2(0.0);
+    }
+
+    if (pardonsLeft == 0) {
+        p.x += randomRange(1u, 0, 1) == 0 ? -u_Jitter : u_Jitter;
+        p.y -= (speed - u_SpeedBias) * u_Fall;
+    }
+
+    bool jump = randomRange(2u, 0, 1000) == 0;
+    if (jump) {
+        p.x = randomColumn(3u);
+    }
+
+    int sparkRoll = spark;
+    float newSpeed = speed;
+    bool reset = false;
+    if (u_FallUp != 0 && p.y >= u_ScreenSize.y) {
+        p.y = 0.0;
+        reset = true;
+    } else if (p.y < 0.0) {
+        p.y = u_ScreenSize.y;
+        reset = true;
+    }
+    if (reset) {
+        p.x = randomColumn(4u);
+        sparkRoll = randomRange(5u, 0, u_ChanceOfSpark);
+        colorShift = mix(-u_ColorVariation, u_ColorVariation, randomUnit(6u));
+        newSpeed = floor(mix(10.0, 20.0, randomUnit(7u)));
+        if (u_FallUp != 0) {
+            newSpeed = -newSpeed;
+        }
+    }
+
+    tf_Position = p;
+    tf_ColorOffset = colorShift;
+    tf_Spark = sparkRoll;
+    tf_Speed = newSpeed;
+    tf_Push = pushForce;
+    tf_Pardons = pardonsLeft;
+    // Teleported raindrops have nothing to interpolate from
+    tf_Velocity = jump || reset ? vec2(0.0) : p - start;
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -7,6 +7,8 @@ struct renderer;
 App *initializeApp(renderer *rnd, const char *name);
 
 #include <renderer.h>
+#include <checkpoint.h>
+#include <render_graph.h>
 
 class App {
 public:
@@ -15,6 +17,16 @@ public:
     virtual void setup() = 0;
     virtual void loop() = 0;
     virtual void destroy() = 0;
+    // Adds the app's state to a checkpoint, apps read theirs back from rnd->checkpoint in setup
+    virtual void saveCheckpoint(CheckpointWriter &) {}
+    // The periodic checkpoint without stalling: start adds what the CPU holds and copies GPU buffers for finish to
+    // add once the renderer's fence after them has passed
+    virtual void startCheckpoint(CheckpointWriter &writer) { saveCheckpoint(writer); }
+    virtual void finishCheckpoint(CheckpointWriter &) {}
+    // Draws the history of a fast-forwarded start into the bound ghosting framebuffer, once before the first frame
+    virtual void warmUp() {}
+    // Declares the app's own passes after the scene it drew, returns what the renderer's post-processing continues from
+    virtual renderResource addRenderPasses(RenderGraph &, const renderResource scene) { return scene; }
 
 protected:
     renderer *rnd;
@@ -1,7 +1,15 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 #include <apps.h>
-#include <fonts.h>
+#include <glyph_cache.h>
+#include <jobs.h>
+#include <apps/matrix_rain.h>
+#include <apps/matrix_rain_grid.h>
+#include <apps/matrix_gpu_rain.h>
+#include <apps/matrix_particles.h>
+#include <philox.h>
+#include <streaming_buffer.h>
+#include <queue>
 #include "matrix_vertex_shader.h"
 #include "matrix_fragment_rainbow_shader.h"
 #include "matrix_fragment_wallpaper_shader.h"
@@ -18,60 +26,194 @@
 #define MATRIX_TEXT_SIZE_DIVISOR 2.0
 #define MATRIX_SPEED_DRAW 0.5
 #define MATRIX_CHANCE_OF_SPARK 5
+// How much brighter than white sparks are drawn when they bloom
+#define MATRIX_SPARK_BLOOM_BRIGHTNESS 4.0f
 #define MATRIX_EFFECT_PER_KEYPRESS 10
 #define MATRIX_DRAW_STRENGTH 100
-#define MATRIX_ROTATION 5
-#define MATRIX_DEBUG false
-#define MATRIX_UP false
+// Simulation ticks allowed per rendered frame before the backlog is dropped
+#define MATRIX_MAX_TICKS_PER_FRAME 5
+// Interaction particles alive at once, spawns past this recycle the slots handed out longest ago
+#define MATRIX_PARTICLES 16384
+// Longest --trails, one history slot more than this has to fit the stamp array in matrix.vert
+#define MATRIX_MAX_TRAIL 31
+// Seconds of analytic motion before the start times are rebased, so they keep their float precision
+#define MATRIX_MOTION_REBASE 600.0
+// Clean records allowed between two dirty ones before they are uploaded as separate ranges
+#define MATRIX_MOTION_RANGE_GAP 16
+// Ghosting left fainter than this is not worth drawing when the warm-up synthesizes the history
+#define MATRIX_WARMUP_MIN_WEIGHT (1.0f / 255.0f)
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+// What a checkpoint keeps besides the raindrop arrays, it only restores into the same configuration
+struct matrixCheckpoint {
+    int32_t count;
+    int32_t width, height;
+    int32_t trailSlots, trailStride, trailHead;
+    uint64_t seed;
+    uint32_t rainFrame;
+    int32_t activeCursorPardons;
+    float baseColor;
+    float tickAccumulator;
+};
 
-struct RainDrawData {
-    float x, y;
+// A stretch of one raindrop's fall between resets, the warm-up keeps the recent ones to draw the history from
+struct matrixWarmUpSegment {
+    float x, y;  // Where the stretch starts
+    float step;  // Fall per tick
     float colorOffset;
     int spark;
+    int begin, end;  // Ticks into the warm-up, end is the tick the raindrop reset on
+};
+
+// What ends a stretch of analytic motion
+enum MatrixMotionEvents : uint8_t {
+    MATRIX_MOTION_RESET,
+    MATRIX_MOTION_JUMP,
+    MATRIX_MOTION_BURST_END
 };
 
-struct RainData {
-    float speed = 0;
-    float pushX, pushY = 0;
-    int cursorPardons = 0;
+// Philox streams, a counter is (raindrop index, rain frame, stream)
+enum MatrixRandomStreams {
+    MATRIX_RANDOM_PLACE,
+    MATRIX_RANDOM_ROLL,
+    MATRIX_RANDOM_RESET,
+    MATRIX_RANDOM_SPAWN,
+    MATRIX_RANDOM_JUMP,
+    MATRIX_RANDOM_SPAWN_PUSH
 };
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 class MatrixApp final : public App {
 public:
     explicit MatrixApp(renderer *rnd) : App(rnd) {};
     void setup() override;
     void loop() override;
     void destroy() override;
+    void saveCheckpoint(CheckpointWriter &writer) override;
+    void startCheckpoint(CheckpointWriter &writer) override;
+    void finishCheckpoint(CheckpointWriter &writer) override;
+    void warmUp() override;
 private:
-    static int random_int(int a, int b);
-    static int random_td_int(int a, int b);
-    static float random_float(float a, float b);
-    static float random_td_float(float a, float b);
-    static int randomMultiplier();
-    static int randomSpark();
-    int randomSpeed() const;
-    static float randomColorOffset();
-    void resetRain(int index);
-    void incrementRain(int index, bool reassigned);
+    static int random_int(uint32_t bits, int a, int b);
+    static int random_td_int(uint32_t bits, int a, int b);
+    static float random_float(uint32_t bits, float a, float b);
+    static float random_td_float(uint32_t bits, float a, float b);
+    static int randomMultiplier(uint32_t bits);
+    static int randomSpark(uint32_t bits);
+    static int randomSpeed(uint32_t bits);
+    static float randomColorOffset(uint32_t bits);
+    void resetRain(int index, uint32_t frame);
+    void beginTick(const RainFrame &frame);
+    void spawnParticles(int amount, float tick);
+    void streamParticles();
+    void rollRain(int begin, int end);
+    void updateRain(const RainFrame &frame, const RainOutput &out);
+    void setupMotion();
+    void startMotion(int index, double time);
+    void advanceMotion(double now);
+    void pushMotion(const RainFrame &frame, double now);
+    void rebaseMotion(double now);
+    void uploadMotion();
+    void bindMotionAttributes(GLuint buffer) const;
+    uint32_t motionTickAt(double time) const;
+    void packInstances(const RainOutput &out, unsigned char *segment, GLintptr velocityXOffset, GLintptr velocityYOffset);
+    void pushRainFromCursors(const RainFrame &frame, int chunks);
+    static void fixupRain(void *context, int index, int events);
+    void bindInstanceAttributes(GLuint buffer, GLsizei stride, GLintptr offset) const;
+    void bindVelocityAttributes(GLuint buffer, GLsizei stride, GLintptr xOffset, GLintptr yOffset) const;
+    void storeInstance(unsigned char *destination, const RainDrawData &instance) const;
+    void addCheckpointState(CheckpointWriter &writer);
+    void addCheckpointRain(CheckpointWriter &writer) const;
+    const matrixCheckpoint *findCheckpoint(int rainLimit) const;
+    void restoreTrail(const matrixCheckpoint &saved);
+    void fastForward(float seconds);
+    float ghostingHistoryFrames() const;
+    void recordTrail(GLuint source, GLintptr offset);
+    void drawTrail();
 
     ShaderProgram *program{};
-    FontAtlas *atlas{};
+    GlyphCache *glyphCache{};
+    // --charset and --charset-text, switched to in turn every --charset-time seconds
+    std::vector<std::vector<uint32_t>> charsets;
+    size_t activeCharset = 0;
+    GLuint ui_MaxCharacters{};
     GLuint wallpaperTexture;
-    GLuint ui_BaseColor{}, ui_Time{};
-    GLuint vertexArray{}, vertexBuffer{};
-    std::vector<RainDrawData> rainDrawData;
-    std::vector<RainData> rainData;
+    GLuint ui_BaseColor{}, ui_Time{}, ui_TickAlpha{};
+    GLuint ui_TrailSlots{}, ui_TrailHead{}, ui_TrailStamps{}, ui_TrailActive{};
+    GLuint ui_History{};
+    GLuint vertexArray{};
+    // Trail mode keeps the last few ticks of instances in a ring of slots and draws them instead of ghosting
+    GLuint trailVertexArray{}, trailBuffer{};
+    GLsizei trailStride = 0;
+    int trailSlots = 0;
+    int trailHead = 0;
+    float trailStamps[MATRIX_MAX_TRAIL + 1]{};
+    // The periodic checkpoint copies the GPU rain state and then the trail history in here, read after the fence
+    GLuint checkpointBuffer{};
+    GLsizeiptr checkpointStateSize = 0;
+    // Kept from fastForward until warmUp has drawn the ghosting history from them
+    std::vector<matrixWarmUpSegment> warmUpSegments;
+    int warmUpTicks = 0;
+    float warmUpTick = 0.0f;
+    float glyphSize = 0.0f;
+    StreamingBuffer instances;
+    // --compact-instances uploads RainCompactData and int16_t velocities, packed from the float staging arrays
+    bool compactInstances = false;
+    GLsizei instanceStride = sizeof(RainDrawData);
+    GLsizei velocityStride = sizeof(float);
+    std::vector<RainDrawData> stagingInstances;
+    std::vector<float> stagingVelocity;
+    // --analytic-rain keeps one motion record per raindrop on the GPU and a queue of when each changes course,
+    // rain.x and rain.y then hold where the current stretch started
+    bool analyticRain = false;
+    GLuint motionBuffer{};
+    GLuint ui_Motion{}, ui_MotionTime{};
+    std::vector<RainMotionData> motion;
+    std::vector<double> motionEventTime;
+    std::vector<uint8_t> motionEvent;
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> motionEvents;
+    std::vector<int> dirtyMotion;
+    // Where the active raindrops are as of the last cursor pass, the grid is kept on these instead of rain.x and rain.y
+    std::vector<float> motionX, motionY;
+    // Raindrops the cursor moved aside, they snap back once it lets go like in the ticked simulation
+    std::vector<int> displacedDrops, pushedDrops;
+    double motionEpoch = 0.0;
+    float motionTick = 0.0f;
+    // Typing and drawing spawn particles instead of taking raindrops from the rain, they are streamed right
+    // after the active raindrops, or through particleVertexArray when the rain never passes through instances
+    ParticlePool particles;
+    int instanceSlots = 0;
+    int drawnParticles = 0;
+    uint32_t particleSpawns = 0;
+    float lastCursorX = 0.0f, lastCursorY = 0.0f;
+    GLuint particleVertexArray{};
+    RainStore rain;
+    // The first activeDrops raindrops are simulated and drawn, the governor can leave the rest asleep
+    int activeDrops = 0;
+    RainGrid grid;
+    RainKernel rainKernel = nullptr;
+    JobPool *jobs = nullptr;
+    GpuRain *gpuRain = nullptr;
+    std::vector<int> chunkCursorPardons;
+    // The raindrops each chunk found in a new grid cell while it was rolled
+    std::vector<std::vector<int>> chunkMovedDrops;
+    Philox4x32 random;
+    uint32_t rainFrame = 0;
+    float tickLength = 0.0f;
+    float tickAccumulator = 0.0f;
     float baseColor = 0.0f;
     float mouseRadius = 0.0f;
     int activeCursorPardons = 0;
     bool useWallPaperShader = false;
-    const float rot_d15 = MATRIX_ROTATION / 15.0;
-    const float rot_d15_m2 = rot_d15 * 2;
-    const float rot_d15_d2 = rot_d15 / 2;
+    // --rain-up, --debug-layout and --no-interaction, the kernel is specialized for them once in setup
+    bool fallUp = false;
+    bool debugLayout = false;
+    bool cursorPush = false;
+    float rot_d15 = 0.0f;
+    float rot_d15_m2 = 0.0f;
+    float rot_d15_d2 = 0.0f;
 };
 
 #endif //MATRIX_H
@@ -0,0 +1,50 @@
+#ifndef MATRIX_GPU_RAIN_H
+#define MATRIX_GPU_RAIN_H
+#include <cstdint>
+#include <shader.h>
+#include <apps/matrix_rain.h>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Per-raindrop state as it lives on the GPU, the first 16 bytes line up with RainDrawData
+// so the same buffer is drawn from directly
+struct GpuRainState {
+    float x, y;
+    float colorOffset;
+    int spark;
+    float speed;
+    float pushX, pushY;
+    int pardons;
+    float velocityX, velocityY;
+};
+
+// Keeps the rain in two GPU buffers and advances it with transform feedback, nothing is read back
+class GpuRain {
+public:
+    void setup(const RainStore &rain, uint64_t seed, float width, float height, float jitter, bool fallUp);
+    // Only the first active raindrops move, the rest keep whatever state they were left in
+    void update(const RainFrame &frame, uint32_t rainFrame, int active);
+    void destroy();
+    // Copies the latest state back into rain, stalls on the GPU so it is only used for checkpoints
+    void readBack(RainStore &rain) const;
+    // Copies the latest state into target at offset on the GPU, unpackState reads it once that has finished
+    void copyState(GLuint target, GLintptr offset) const;
+    void unpackState(const GpuRainState *state, RainStore &rain) const;
+    GLsizeiptr stateSize() const { return static_cast<GLsizeiptr>(count) * sizeof(GpuRainState); }
+
+    // Holds the latest state after update
+    GLuint stateBuffer() const { return buffers[current]; }
+
+private:
+    ShaderProgram *program{};
+    GLuint buffers[2]{}, vertexArrays[2]{};
+    int current = 0;
+    int count = 0;
+    GLuint ui_Frame{}, ui_Cursors{}, ui_CursorCount{}, ui_CursorRadius{}, ui_SpeedBias{}, ui_Fall{};
+};
+
+#endif //MATRIX_GPU_RAIN_H
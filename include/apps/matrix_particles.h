@@ -0,0 +1,40 @@
+#ifndef MATRIX_PARTICLES_H
+#define MATRIX_PARTICLES_H
+#include <vector>
+#include <apps/matrix_rain.h>
+
+// A glyph thrown out by the cursor or the keyboard, it expands along its push for life ticks and then falls
+struct RainParticle {
+    float x, y;
+    float pushX, pushY;
+    float speed;
+    float colorOffset;
+    int spark;
+    int life;
+    float velocityX, velocityY;  // Distance moved during the last tick
+};
+
+// Fixed capacity pool for the interaction particles, nothing is allocated after allocate(). Live particles
+// stay packed at the front so they can be appended to the rain in the same instanced draw: a freed slot takes
+// the last live particle, and the slots past the live ones are the free list, so both ends are O(1).
+class ParticlePool {
+public:
+    void allocate(int capacity);
+
+    // Takes a free slot, once the pool is full spawns recycle live slots round robin instead
+    RainParticle &spawn();
+    // Advances every particle by one tick and frees the ones that left the screen
+    void update(const RainFrame &frame);
+    // Writes the live particles to out from index begin on, the same way the kernels write raindrops
+    void write(const RainOutput &out, int begin) const;
+
+    int live() const { return count; }
+    int capacity() const { return static_cast<int>(particles.size()); }
+
+private:
+    std::vector<RainParticle> particles;
+    int count = 0;
+    int recycle = 0;
+};
+
+#endif //MATRIX_PARTICLES_H
@@ -0,0 +1,127 @@
+#ifndef MATRIX_RAIN_H
+#define MATRIX_RAIN_H
+#include <cstdint>
+
+// Width of the widest SIMD kernel, arrays are padded and aligned to it
+#define MATRIX_RAIN_LANES 16
+#define MATRIX_RAIN_ALIGNMENT 64
+// Raindrops per job, a multiple of MATRIX_RAIN_LANES so every chunk starts on a cache line
+#define MATRIX_RAIN_CHUNK 1024
+// Most points (mouse or touches) pushing raindrops away in one tick
+#define MATRIX_RAIN_MAX_CURSORS 4
+// Steps per pixel of the fixed point positions in RainCompactData, 1/4 pixel up to 8191 pixels out. Each step is
+// split again into MATRIX_RAIN_FIXED_FRACTION, the glyph edges shimmer visibly against the float path otherwise
+#define MATRIX_RAIN_FIXED_SCALE 4.0f
+#define MATRIX_RAIN_FIXED_FRACTION 256
+// Steps per pixel of the packed velocities, 1/16 pixel up to 2047 pixels moved in one tick
+#define MATRIX_RAIN_VELOCITY_SCALE 16.0f
+
+// Interleaved per-instance data, uploaded to the GPU every frame
+struct RainDrawData {
+    float x, y;
+    float colorOffset;
+    int spark;
+};
+
+// RainDrawData packed to 8 bytes for --compact-instances, the velocities shrink to int16_t alongside it
+struct RainCompactData {
+    int16_t x, y;          // Fixed point, MATRIX_RAIN_FIXED_SCALE steps per pixel
+    uint8_t colorOffset;   // Only the fraction matters, the hue wraps around
+    uint8_t spark;
+    uint8_t fractionX, fractionY;  // MATRIX_RAIN_FIXED_FRACTION parts of a step added to x and y
+};
+
+// One straight stretch of a raindrop's motion for --analytic-rain, the vertex shader moves it from
+// x, y at startTime by the velocity, the first 16 bytes line up with RainDrawData
+struct RainMotionData {
+    float x, y;
+    float colorOffset;
+    int spark;
+    float velocityX, velocityY;  // Pixels per second
+    float startTime;             // Seconds since the motion epoch
+    float reserved;
+};
+
+enum RainEvents {
+    RAIN_CURSOR_MISS = 1 << 0, // The 1 in 11 roll that lets a raindrop ignore the cursor
+    RAIN_COLUMN_JUMP = 1 << 1, // The 1 in 1001 roll that moves a raindrop to another column
+    RAIN_RESET =       1 << 2, // The raindrop left the screen
+    RAIN_PUSHED =      1 << 3  // Set by the cursor pass, the kernel skips expanding and restoring these
+};
+
+// Switches baked into each instantiation of the update kernel, picked once at setup from the options
+enum RainFeatures : unsigned {
+    RAIN_FEATURE_FALL_UP =     1 << 0, // Raindrops rise and reset when they leave the top
+    RAIN_FEATURE_INTERACTIVE = 1 << 1, // Cursor pushes and expanding from the cursor
+    RAIN_FEATURE_STATIC =      1 << 2, // Debug layout, every glyph stays where it was placed
+    RAIN_FEATURE_COMBINATIONS = 1 << 3
+};
+
+struct RainCursor {
+    float x, y;
+};
+
+// Struct-of-arrays raindrop state, every array is aligned to MATRIX_RAIN_ALIGNMENT
+struct RainStore {
+    int count = 0;
+    float *x = nullptr, *y = nullptr;
+    float *speed = nullptr;
+    float *pushX = nullptr, *pushY = nullptr;
+    float *colorOffset = nullptr;
+    int *pardons = nullptr;
+    int *spark = nullptr;
+
+    // Random inputs rolled before every update
+    float *jitter = nullptr;
+    int *rolls = nullptr;
+    // Written by the cursor pass, only valid where rolls has RAIN_PUSHED
+    float *forceX = nullptr, *forceY = nullptr;
+
+    void allocate(int count);
+    void release();
+
+private:
+    void *block = nullptr;
+};
+
+// Everything an update needs from the renderer, read once per frame instead of once per raindrop
+struct RainFrame {
+    RainCursor cursors[MATRIX_RAIN_MAX_CURSORS];
+    int cursorCount; // 0 turns interaction off
+    float cursorRadius;
+    float speedBias;
+    float fall;
+    float height;
+    bool fallUp;
+
+    // Called for the rare raindrops that jumped column or left the screen
+    void (*fixup)(void *context, int index, int events);
+    void *context;
+};
+
+// Where an update is written, the velocity arrays hold how far each raindrop moved during the tick
+// and are zero for raindrops that jumped column or reset, so the renderer can interpolate between ticks
+struct RainOutput {
+    RainDrawData *instances;
+    float *velocityX, *velocityY;
+};
+
+RainCompactData packRainInstance(const RainDrawData &instance);
+// Packs raindrops [begin, end) of a float update into the compact layout
+void packRainOutput(const RainOutput &in, int begin, int end, RainCompactData *instances, int16_t *velocityX, int16_t *velocityY);
+
+// Updates raindrops [begin, end), writes them to out and returns how many still have cursor pardons
+using RainKernel = int (*)(RainStore &rain, const RainFrame &frame, int begin, int end, const RainOutput &out);
+
+// Each returns its instruction set's kernel for a set of RainFeatures
+RainKernel rainKernelScalar(unsigned features);
+#ifdef MATRIX_RAIN_X86
+RainKernel rainKernelSse2(unsigned features);
+RainKernel rainKernelAvx2(unsigned features);
+RainKernel rainKernelAvx512(unsigned features);
+#endif
+
+// Picks the widest kernel the CPU supports, specialized for the features
+RainKernel selectRainKernel(unsigned features);
+
+#endif //MATRIX_RAIN_H
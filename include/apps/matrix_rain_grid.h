@@ -0,0 +1,52 @@
+#ifndef MATRIX_RAIN_GRID_H
+#define MATRIX_RAIN_GRID_H
+#include <algorithm>
+#include <vector>
+#include <apps/matrix_rain.h>
+
+// Uniform grid over the screen, every cell keeps a doubly linked list of the raindrops inside it.
+// Raindrops outside the screen belong to the nearest border cell, so queries never miss them.
+class RainGrid {
+public:
+    void resize(float width, float height, float cellSize, int count);
+
+    // Appends the raindrops in [begin, end) whose cell changed since they were last relinked to moved. Only reads
+    // the grid, so disjoint ranges can be collected at once while each chunk is rolled
+    void collect(const RainStore &rain, int begin, int end, std::vector<int> &moved) const;
+    // Moves the collected raindrops into their new cells
+    void relink(const RainStore &rain, const std::vector<int> &moved);
+
+    // Calls visit(index) for every raindrop in a cell overlapping the disc
+    template<typename Visit>
+    void query(const float x, const float y, const float radius, Visit &&visit) const {
+        const int left = column(x - radius), right = column(x + radius);
+        const int bottom = row(y - radius), top = row(y + radius);
+        for (int r = bottom; r <= top; ++r) {
+            for (int c = left; c <= right; ++c) {
+                for (int i = heads[r * columns + c]; i != -1; i = next[i]) {
+                    visit(i);
+                }
+            }
+        }
+    }
+
+private:
+    int column(const float x) const { return std::clamp(static_cast<int>(x / cellSize), 0, columns - 1); }
+    int row(const float y) const { return std::clamp(static_cast<int>(y / cellSize), 0, rows - 1); }
+    int cell(const float x, const float y) const { return row(y) * columns + column(x); }
+    void link(int index, int cell);
+    void unlink(int index);
+
+    float cellSize = 1.0f;
+    int columns = 1, rows = 1;
+    std::vector<int> heads;
+    std::vector<int> next, previous, cells;
+};
+
+// Finds the first count raindrops in reach of the frame's cursors, flags them RAIN_PUSHED and stores their force.
+// Must run after the rolls and before the kernel, each raindrop is pushed by the first cursor that reaches it.
+// The ones past count are asleep, they keep whatever cell they were last relinked to and are skipped.
+// Appends every raindrop it flags to pushed when given one.
+void pushRain(RainStore &rain, const RainGrid &grid, const RainFrame &frame, int count, std::vector<int> *pushed = nullptr);
+
+#endif //MATRIX_RAIN_GRID_H
@@ -0,0 +1,190 @@
+#ifndef MATRIX_RAIN_KERNEL_H
+#define MATRIX_RAIN_KERNEL_H
+// Only included by the per-instruction-set kernel sources, everything here has internal linkage
+// so that code compiled for one instruction set never leaks into another. The lane structs are in an
+// anonymous namespace too, their inline members would otherwise be shared between the objects.
+#include "apps/matrix_rain.h"
+#include <cmath>
+
+namespace {
+
+// One raindrop at a time, used for the tails and on CPUs without a vector kernel
+struct ScalarLanes {
+    static constexpr int width = 1;
+    using F = float;
+    using I = int;
+    using M = bool;
+
+    static F load(const float *p) { return *p; }
+    static void store(float *p, const F v) { *p = v; }
+    static void storeu(float *p, const F v) { *p = v; }
+    static I loadi(const int *p) { return *p; }
+    static void storei(int *p, const I v) { *p = v; }
+    static F set1(const float v) { return v; }
+    static I set1i(const int v) { return v; }
+
+    static F add(const F a, const F b) { return a + b; }
+    static F sub(const F a, const F b) { return a - b; }
+    static F mul(const F a, const F b) { return a * b; }
+    static F div(const F a, const F b) { return a / b; }
+    static F sqrt(const F a) { return std::sqrt(a); }
+
+    static M lt(const F a, const F b) { return a < b; }
+    static M ge(const F a, const F b) { return a >= b; }
+    static M ne(const F a, const F b) { return a != b; }
+    static M eqi(const I a, const I b) { return a == b; }
+    static M gti(const I a, const I b) { return a > b; }
+    static M test(const I a, const int bit) { return (a & bit) != 0; }
+
+    static M and_(const M a, const M b) { return a && b; }
+    static M or_(const M a, const M b) { return a || b; }
+    static M andnot(const M a, const M b) { return a && !b; }
+    static F select(const M m, const F t, const F f) { return m ? t : f; }
+    static I decrement(const I a, const M m) { return m ? a - 1 : a; }
+    static unsigned bits(const M m) { return m ? 1 : 0; }
+
+    static void storeInstances(RainDrawData *out, const F x, const F y, const F colorOffset, const I spark) {
+        out->x = x;
+        out->y = y;
+        out->colorOffset = colorOffset;
+        out->spark = spark;
+    }
+};
+
+static inline int rainPopCount(unsigned bits) {
+    int count = 0;
+    for (; bits != 0; bits &= bits - 1) {
+        count++;
+    }
+    return count;
+}
+
+// Mirrors the scalar incrementRain with masks instead of branches, L::width raindrops starting at i.
+// Features is a set of RainFeatures, the switches are resolved at compile time so none of them branch per raindrop
+template<typename L, unsigned Features>
+static inline int rainBlock(RainStore &rain, const RainFrame &frame, const int i, const RainOutput &out) {
+    using F = typename L::F;
+    using I = typename L::I;
+    using M = typename L::M;
+
+    const F zero = L::set1(0.0f);
+    const I zeroi = L::set1i(0);
+
+    const F startX = L::load(rain.x + i);
+    const F startY = L::load(rain.y + i);
+    F x = startX;
+    F y = startY;
+    I pardons = zeroi;
+    const I rolls = L::loadi(rain.rolls + i);
+
+    if constexpr ((Features & RAIN_FEATURE_INTERACTIVE) != 0) {
+        F pushX = L::load(rain.pushX + i);
+        F pushY = L::load(rain.pushY + i);
+        pardons = L::loadi(rain.pardons + i);
+
+        // Push the raindrop away from the cursor, the cursor pass found the raindrops in range and their force
+        const M pardoned = L::gti(pardons, zeroi);
+        const M pushed = L::test(rolls, RAIN_PUSHED);
+        const F forceX = L::select(pushed, L::load(rain.forceX + i), zero);
+        const F forceY = L::select(pushed, L::load(rain.forceY + i), zero);
+        x = L::add(x, forceX);
+        y = L::add(y, forceY);
+        const F pushedX = L::add(pushX, forceX);
+        const F pushedY = L::add(pushY, forceY);
+
+        // Expand from the cursor
+        const M expanding = L::andnot(pardoned, pushed);
+        x = L::select(expanding, L::add(x, pushX), x);
+        y = L::select(expanding, L::add(y, pushY), y);
+        pardons = L::decrement(pardons, expanding);
+        const M expired = L::and_(expanding, L::eqi(pardons, zeroi));
+
+        // Reset the push force
+        const M restoring = L::andnot(L::andnot(L::or_(L::ne(pushX, zero), L::ne(pushY, zero)), pushed), pardoned);
+        x = L::select(restoring, L::sub(x, pushX), x);
+        y = L::select(restoring, L::sub(y, pushY), y);
+
+        const M cleared = L::or_(expired, restoring);
+        pushX = L::select(cleared, zero, pushedX);
+        pushY = L::select(cleared, zero, pushedY);
+
+        L::store(rain.pushX + i, pushX);
+        L::store(rain.pushY + i, pushY);
+        L::storei(rain.pardons + i, pardons);
+    }
+
+    // Move the raindrop along its path, the debug layout keeps every glyph where it was placed
+    if constexpr ((Features & RAIN_FEATURE_STATIC) == 0) {
+        const F step = L::mul(L::sub(L::load(rain.speed + i), L::set1(frame.speedBias)), L::set1(frame.fall));
+        if constexpr ((Features & RAIN_FEATURE_INTERACTIVE) != 0) {
+            const M falling = L::eqi(pardons, zeroi);
+            x = L::select(falling, L::add(x, L::load(rain.jitter + i)), x);
+            y = L::select(falling, L::sub(y, step), y);
+        } else {
+            x = L::add(x, L::load(rain.jitter + i));
+            y = L::sub(y, step);
+        }
+    }
+
+    L::store(rain.x + i, x);
+    L::store(rain.y + i, y);
+
+    L::storeu(out.velocityX + i, L::sub(x, startX));
+    L::storeu(out.velocityY + i, L::sub(y, startY));
+
+    int active = 0;
+    if constexpr ((Features & RAIN_FEATURE_INTERACTIVE) != 0) {
+        active = rainPopCount(L::bits(L::gti(pardons, zeroi)));
+    }
+
+    // Column jumps and resets are rare, hand them to the caller one raindrop at a time
+    M reset = L::lt(y, zero);
+    if constexpr ((Features & RAIN_FEATURE_FALL_UP) != 0) {
+        reset = L::or_(reset, L::ge(y, L::set1(frame.height)));
+    }
+    const unsigned jumpBits = (Features & RAIN_FEATURE_STATIC) != 0 ? 0 : L::bits(L::test(rolls, RAIN_COLUMN_JUMP));
+    const unsigned resetBits = L::bits(reset);
+    if ((jumpBits | resetBits) != 0) {
+        for (int lane = 0; lane < L::width; ++lane) {
+            const int events = (jumpBits >> lane & 1 ? RAIN_COLUMN_JUMP : 0) | (resetBits >> lane & 1 ? RAIN_RESET : 0);
+            if (events != 0) {
+                frame.fixup(frame.context, i + lane, events);
+                // Teleported, nothing to interpolate from
+                out.velocityX[i + lane] = 0.0f;
+                out.velocityY[i + lane] = 0.0f;
+            }
+        }
+        x = L::load(rain.x + i);
+        y = L::load(rain.y + i);
+    }
+
+    L::storeInstances(out.instances + i, x, y, L::load(rain.colorOffset + i), L::loadi(rain.spark + i));
+    return active;
+}
+
+template<typename L, unsigned Features>
+static int rainKernel(RainStore &rain, const RainFrame &frame, const int begin, const int end, const RainOutput &out) {
+    int active = 0;
+    int i = begin;
+    for (; i + L::width <= end; i += L::width) {
+        active += rainBlock<L, Features>(rain, frame, i, out);
+    }
+    for (; i < end; ++i) {
+        active += rainBlock<ScalarLanes, Features>(rain, frame, i, out);
+    }
+    return active;
+}
+
+// Instantiates the kernel for every combination of features and returns the one asked for
+template<typename L, unsigned Features = 0>
+static RainKernel rainKernelWith(const unsigned features) {
+    if constexpr (Features == RAIN_FEATURE_COMBINATIONS) {
+        return nullptr;
+    } else {
+        return features == Features ? rainKernel<L, Features> : rainKernelWith<L, Features + 1>(features);
+    }
+}
+
+} // namespace
+
+#endif //MATRIX_RAIN_KERNEL_H
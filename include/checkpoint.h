@@ -0,0 +1,62 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECKPOINT_MAGIC 0x50435843  // "CXCP"
+#define CHECKPOINT_VERSION 1
+// Sections start on this boundary so arrays can be read straight out of the mapping
+#define CHECKPOINT_ALIGNMENT 64
+// Seconds of running between periodic checkpoints
+#define CHECKPOINT_INTERVAL 60.0
+
+// Four characters naming a section
+constexpr uint32_t checkpointTag(const char (&tag)[5]) {
+    return static_cast<uint32_t>(tag[0]) | static_cast<uint32_t>(tag[1]) << 8 |
+           static_cast<uint32_t>(tag[2]) << 16 | static_cast<uint32_t>(tag[3]) << 24;
+}
+
+// Collects tagged sections in memory on the render thread, the file is written on a worker
+class CheckpointWriter {
+public:
+    ~CheckpointWriter();
+
+    // Returns the space for a section of size bytes, valid until the next call
+    void *add(uint32_t tag, size_t size);
+    void add(uint32_t tag, const void *data, size_t size);
+
+    // Starts writing to path, replaces the old file only once the new one is complete
+    void commit(const std::string &path);
+    // Blocks until the last commit is on disk
+    void wait();
+
+private:
+    std::vector<unsigned char> data;
+    uint32_t sections = 0;
+    std::thread worker;
+};
+
+// Maps a checkpoint read only, sections point straight into the mapping
+class CheckpointReader {
+public:
+    ~CheckpointReader();
+
+    // False when the file is missing or not a checkpoint of this version
+    bool open(const std::string &path);
+    void close();
+
+    // Returns the section, or nullptr when it is missing or not size bytes long
+    const void *section(uint32_t tag, size_t size) const;
+
+private:
+    const unsigned char *mapped = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    std::vector<unsigned char> contents;
+#endif
+};
+
+#endif //CHECKPOINT_H
@@ -14,8 +14,11 @@ struct tickRateClock {
     chrono_impl::steady_clock::time_point lastFrameSwapTime{};
     float deltaTime{};
     float frameSwapDeltaTime{};
+    // Sum of every frame delta since initialize, so a replayed run sees the same times
+    double elapsedTime{};
 
     void calculateDeltaTime();
+    void advance(float deltaTime);
 
     void calculateFrameSwapDeltaTime();
 
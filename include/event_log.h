@@ -0,0 +1,59 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+struct options;
+struct groupedEvents;
+
+#define EVENT_LOG_MAGIC 0x5645584D  // "MXEV"
+#define EVENT_LOG_VERSION 1
+
+// Everything a rendered frame depends on that does not come from the seed
+struct eventLogFrame {
+    float deltaTime = 0.0f;
+    bool swapped = false;  // The frame swapped the ghosting history
+    long mouseX = 0, mouseY = 0, keysPressed = 0;
+    bool mouseLeft = false, mouseRight = false, mouseMiddle = false;
+    int quality = 0;  // Governor level the next frame renders with
+};
+
+// A frame record is a byte of flags, the frame delta and then only the fields that changed
+enum EventLogFlags {
+    EVENT_LOG_SWAPPED =  1 << 0,
+    EVENT_LOG_MOUSE_X =  1 << 1,
+    EVENT_LOG_MOUSE_Y =  1 << 2,
+    EVENT_LOG_KEYS =     1 << 3,
+    EVENT_LOG_BUTTONS =  1 << 4,
+    EVENT_LOG_QUALITY =  1 << 5
+};
+
+class EventRecorder {
+public:
+    // Writes the header, exits when the file cannot be created
+    void open(const std::string &path, const options &opts);
+    void write(const eventLogFrame &frame);
+    void close();
+
+private:
+    std::ofstream file;
+    eventLogFrame previous;
+};
+
+class EventReplayer {
+public:
+    // Reads the header, takes the recorded seed unless one was given and exits when the file is unusable
+    void open(const std::string &path, options &opts);
+    // Moves on to the next frame, false once the log has run out
+    bool next();
+    void apply(groupedEvents *events) const;
+
+    const eventLogFrame &frame() const { return current; }
+
+private:
+    std::ifstream file;
+    eventLogFrame current;
+};
+
+#endif //EVENT_LOG_H
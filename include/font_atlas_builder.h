@@ -0,0 +1,55 @@
+#ifndef FONT_ATLAS_BUILDER_H
+#define FONT_ATLAS_BUILDER_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fonts.h>
+
+// Empty texels kept around every glyph, so bilinear filtering never reaches into the next one
+#define FONT_ATLAS_DEFAULT_PADDING 2
+// The characters of the embedded atlas, in glyph index order
+#define FONT_ATLAS_DEFAULT_CHARACTERS "ﾊﾐﾋｰｳｼﾅﾓﾆｻﾜﾂｵﾘｱﾎﾃﾏｹﾒｴｶｷﾑﾕﾗｾﾈｽﾀﾇﾍ012345789Z:・.\"=*+-<>¦｜"
+
+// An atlas rasterized from a TrueType font, in the same layout as the embedded one
+struct builtFontAtlas {
+    int width = 0;
+    int height = 0;
+    int size = 0;
+    std::vector<unsigned char> pixels;  // Coverage, the rows from the top
+    std::vector<CharacterInfo> characters;  // In codepoint order, yOffset counts from the bottom
+};
+
+std::vector<uint32_t> decodeUtf8(const std::string &text);
+
+// Rasterizes every codepoint at size pixels per em and skyline packs them with padding into the atlas of least
+// area. trim cuts every glyph to its ink, otherwise the cells are as wide as the advance and size tall with the
+// glyphs on one baseline, like the embedded atlas. False when the font can't be read
+bool buildFontAtlas(const std::vector<unsigned char> &font, const std::vector<uint32_t> &codepoints, int size,
+                    int padding, bool trim, builtFontAtlas &atlas);
+
+struct stbtt_fontinfo;
+
+// A font kept open to rasterize glyphs one at a time, in the untrimmed cell layout of buildFontAtlas
+class GlyphRasterizer {
+public:
+    GlyphRasterizer();
+    ~GlyphRasterizer();
+
+    // Takes the font file, false when it can't be read
+    bool open(std::vector<unsigned char> data, int pixels, int padding);
+    // The widest cell any glyph can have, padding included
+    int widestCell() const;
+    // The glyph's cell with padding around it, false when the font has no glyph for codepoint
+    bool rasterize(uint32_t codepoint, glyphBitmap &glyph) const;
+
+private:
+    std::vector<unsigned char> font;
+    std::unique_ptr<stbtt_fontinfo> info;
+    float scale = 0.0f;
+    int size = 0;
+    int margin = 0;
+    int baseline = 0;
+};
+
+#endif //FONT_ATLAS_BUILDER_H
@@ -1,14 +1,16 @@
 #ifndef FONTS_H
 #define FONTS_H
 
-#ifdef __ANDROID__
-#include <GLES3/gl3.h>
-#else
-#include <glad.h>
-#endif
-
+#include <cstdint>
+#include <string>
 #include <vector>
 
+// Texels from a glyph's edge to where its distance field stops changing, about the most texels a
+// screen pixel spans when the glyphs are drawn small
+#define FONT_DISTANCE_FIELD_SPREAD 16.0f
+// Bumped when the layout of rasterized atlases changes, so old cache files are ignored
+#define FONT_CACHE_VERSION 2
+
 struct CharacterInfo {
     unsigned int xOffset;
     unsigned int yOffset;
@@ -21,14 +23,34 @@ struct FontInfo {
     const CharacterInfo* characterInfoList;
 };
 
-struct FontAtlas {
-    GLuint glyphTexture, glyphBuffer;
-    float atlasWidth;
-    float atlasHeight;
+// One glyph cell, the rows from the top
+struct glyphBitmap {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
 
-    void destroy() const;
+// Where the glyph cache gets the pixels of the glyphs it doesn't hold from
+class GlyphSource {
+public:
+    virtual ~GlyphSource() = default;
+    // false when the font has no glyph for codepoint
+    virtual bool rasterize(uint32_t codepoint, glyphBitmap &glyph) = 0;
+
+    int size = 0;  // Pixels per em the glyphs are drawn at
+    int cellWidth = 0, cellHeight = 0;  // The largest cell rasterize can return
+    bool distanceField = false;  // Texels hold the distance to the glyph edge, 0.5 on it, instead of coverage
 };
 
-FontAtlas *createFontTextureAtlas(const unsigned char *source, const FontInfo *fontInfo);
+// The cells of an embedded atlas, source holds the characters of FONT_ATLAS_DEFAULT_CHARACTERS in order.
+// distanceField turns every cell into a signed distance field as it is rasterized
+GlyphSource *createGlyphSource(const unsigned char *source, const FontInfo *fontInfo, bool distanceField = false);
+// The TrueType font at path at size pixels per em, in the cell layout of the embedded atlas. The characters of the
+// embedded atlas are read from the disk cache when the font was rasterized at this size before, every other one is
+// rasterized when it is first asked for. nullptr when the font can't be read so the embedded atlas can be used instead
+GlyphSource *createGlyphSource(const std::string &path, int size, bool distanceField = false);
+
+// The characters a charset name stands for, false for an unknown name
+bool findCharset(const std::string &name, std::vector<uint32_t> &codepoints);
 
 #endif //FONTS_H
@@ -0,0 +1,93 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+#include <cstdint>
+#include <fonts.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Layers of the glyph texture array and their side, the whole budget is allocated up front: 8 MB of R8
+#define GLYPH_CACHE_PAGE_SIZE 1024
+#define GLYPH_CACHE_PAGES 8
+// Empty texels below and right of every slot, so bilinear filtering never reaches into the next glyph
+#define GLYPH_CACHE_SLOT_GAP 2
+// Glyphs rasterized per update while a charset switch fills the cache, the previous charset is drawn until then
+#define GLYPH_CACHE_GLYPHS_PER_UPDATE 64
+// Glyphs in a row of the glyph table, matrix.vert splits the index by it
+#define GLYPH_TABLE_WIDTH 256
+// The glyph table is bound here, the pages on unit 0 and the wallpaper on unit 1
+#define GLYPH_TABLE_TEXTURE_UNIT 2
+
+// A glyph of the charset the shader picks from
+struct cachedGlyph {
+    CharacterInfo character;  // In its page, yOffset counts from the bottom
+    unsigned int layer;
+};
+
+// Glyphs live in fixed size slots cut from the layers of one texture array, each slot remembers which charset
+// switch last used it. A switch only rasterizes the glyphs that aren't resident, into free slots or over the least
+// recently used ones, and rewrites the glyph table the vertex shader looks the glyphs up in. requestCharset spreads
+// the rasterizing over updates and never evicts the glyphs of the charset still shown
+class GlyphCache {
+public:
+    // Takes the source, the slots are cut as large as its largest cell
+    void create(GlyphSource *glyphSource);
+    void destroy();
+
+    // Makes codepoints the glyphs the shader picks from, in order. Characters the font lacks are left out and
+    // the rest is cut at what the cache holds, false and nothing changes when none of them are in the font
+    bool setCharset(const std::vector<uint32_t> &codepoints);
+    // Starts switching to codepoints like setCharset, replacing a switch that hasn't finished
+    void requestCharset(const std::vector<uint32_t> &codepoints);
+    // Rasterizes up to budget glyphs of the requested charset, true once it replaced the glyphs and the table
+    bool update(int budget = GLYPH_CACHE_GLYPHS_PER_UPDATE);
+    // Glyphs the cache can hold at once
+    size_t capacity() const { return slots.size(); }
+    // The pages on texture unit 0 and the glyph table on GLYPH_TABLE_TEXTURE_UNIT, unit 0 is left active
+    void bind() const;
+
+    int size = 0;  // Pixels per em the glyphs are drawn at
+    int pageSize = 0;
+    bool distanceField = false;
+    std::vector<cachedGlyph> glyphs;  // The active charset
+
+private:
+    struct glyphSlot {
+        uint32_t codepoint = 0;
+        uint64_t lastUse = 0;  // 0 while the slot is free
+        int width = 0, height = 0;
+    };
+
+    cachedGlyph placeGlyph(int slot) const;
+    void uploadGlyph(int slot, const glyphBitmap &glyph);
+    void writeTable();
+
+    std::unique_ptr<GlyphSource> source;
+    GLuint pageTexture{}, tableTexture{};
+    int slotWidth = 0, slotHeight = 0;
+    int columns = 0, slotsPerPage = 0;
+    uint64_t stamp = 0;
+    std::vector<glyphSlot> slots;
+    std::unordered_map<uint32_t, int> resident;
+    std::unordered_set<uint32_t> absent;  // Codepoints the font has no glyph for, never asked for again
+    std::vector<bool> shown;  // The slots of the glyphs the table points at, never evicted
+
+    // The switch in progress, wanted is worked through from next on
+    bool pending = false;
+    std::vector<uint32_t> wanted;
+    size_t next = 0;
+    std::vector<int> victims;
+    size_t nextVictim = 0;
+    std::vector<cachedGlyph> charset;
+    std::vector<int> charsetSlots;
+    int missing = 0, dropped = 0;
+};
+
+#endif //GLYPH_CACHE_H
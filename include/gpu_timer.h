@@ -0,0 +1,41 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+#include <string>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Timestamp pairs in flight, results are read a few frames late instead of stalling on them
+#define GPU_TIMER_QUERIES 4
+// Timed frames averaged into one report
+#define GPU_TIMER_REPORT_FRAMES 600
+
+// GPU time of one stage of a frame. Timestamps instead of a GL_TIME_ELAPSED query, the quality governor
+// already has one open around the whole frame. GLES has no timestamps, so nothing is timed on Android
+class GpuTimer {
+public:
+    void initialize(const char *name);
+    void destroy();
+
+    // Bracket the stage's GL commands, a frame that skips the stage just isn't counted
+    void begin();
+    void end();
+    // Collects the finished queries and prints the average every GPU_TIMER_REPORT_FRAMES timed frames
+    void frameEnd();
+
+private:
+    std::string name;
+    double time = 0.0;
+    int frames = 0;
+#ifndef __ANDROID__
+    GLuint queries[GPU_TIMER_QUERIES][2]{};
+    bool queryPending[GPU_TIMER_QUERIES]{};
+    int nextQuery = 0;
+    bool queryActive = false;
+#endif
+};
+
+#endif //GPU_TIMER_H
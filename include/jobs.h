@@ -0,0 +1,47 @@
+#ifndef JOBS_H
+#define JOBS_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, each with its own deque of chunk indices.
+// Owners pop from the back of their deque and idle threads steal from the front of the others.
+class JobPool {
+public:
+    // Number of threads including the caller, 0 picks one per core
+    explicit JobPool(int threads);
+    ~JobPool();
+
+    int threadCount() const;
+
+    // Runs job(chunk) for every chunk in [0, chunks) and returns once all of them finished.
+    // The calling thread works on chunks too.
+    void parallelFor(int chunks, const std::function<void(int)> &job);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> chunks;
+    };
+
+    bool take(int self, int &chunk);
+    void work(int self);
+    void workerLoop(int self);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)> *job = nullptr;
+    std::atomic<int> remaining{0};
+    unsigned long generation = 0;
+    bool quit = false;
+};
+
+#endif //JOBS_H
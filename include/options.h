@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <vector>
 
 #ifdef __ANDROID__
 #include <GLES3/gl3.h>
@@ -14,7 +15,8 @@
 
 enum PostProcessingOptions {
     GHOSTING = 1 << 0,
-    BLUR =     1 << 1
+    BLUR =     1 << 1,
+    BLOOM =    1 << 2   // Off unless --bloom allows it
 };
 
 struct options {
@@ -23,7 +25,7 @@ struct options {
     long width = 800;
     long height = 600;
     uint8_t postProcessingOptions = 0;
-    uint8_t userAllowedPostProcessingOptions = 0xFF;
+    uint8_t userAllowedPostProcessingOptions = 0xFF & ~BLOOM;
     char* app = new char[256];
     GLfloat blurSize = 1.0f;
     GLfloat ghostingBlurSize = 0.0f;
@@ -31,6 +33,33 @@ struct options {
     float swapTime = 1.0f / 60.0f;  // Framerate basically
     bool loopWithSwap = true;
     std::optional<std::string> wallpaperImagePath = std::nullopt;
+    std::optional<std::string> fontPath = std::nullopt;  // TrueType font rasterized at the size the glyphs are drawn at
+    std::vector<std::string> charsets = {"matrix"};  // Taking turns every charsetTime seconds
+    std::optional<std::string> charsetText = std::nullopt;  // The characters of one more charset, UTF-8
+    float charsetTime = 20.0f;
+    std::optional<uint64_t> seed = std::nullopt;
+    std::optional<int> drops = std::nullopt;
+    int threads = 0;  // 0 uses every core
+    bool gpuRain = false;
+    bool analyticRain = false;  // Move the raindrops in the vertex shader, upload only the ones that change course
+    bool compactInstances = false;  // Upload 8 byte fixed point instances instead of 16 byte float ones
+    bool rainUp = false;
+    bool interaction = true;  // Cursor pushes, typing and drawing
+    bool debugLayout = false;  // Every glyph of the font laid out still, for checking the atlas
+    bool distanceFieldGlyphs = false;  // Antialias the glyph edges from a distance field atlas instead of MSAA
+    int rotation = 5;  // Glyph rotation, also sets how far raindrops drift sideways
+    int simRate = 30;  // Simulation ticks per second, 0 ticks once per rendered frame
+    int trails = 0;  // Glyphs drawn behind every raindrop, 0 keeps framebuffer ghosting
+#ifdef __ANDROID__
+    bool accumulateGhosting = true;  // Android draws straight to the window, so the window is faded instead
+#else
+    bool accumulateGhosting = false;  // Fade one persistent framebuffer instead of blending in the last frame
+#endif
+    float warmUp = 2.0f;  // Seconds fast-forwarded before the first frame, 0 starts from empty trails
+    bool qualityGovernor = true;  // Trade quality for frame time when frames go over swapTime
+    std::optional<std::string> recordPath = std::nullopt;
+    std::optional<std::string> replayPath = std::nullopt;
+    std::optional<std::string> checkpointPath = std::nullopt;
 
     void maskPostProcessingOptionsWithUserAllowed();
 };
@@ -0,0 +1,46 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Every call is a pure function of the key and the counter, so values can be drawn in any order,
+// on any thread, and the same (seed, index, frame, stream) always gives the same four lanes.
+struct Philox4x32 {
+    uint32_t key[2]{};
+
+    explicit Philox4x32(const uint64_t seed = 0) {
+        key[0] = static_cast<uint32_t>(seed);
+        key[1] = static_cast<uint32_t>(seed >> 32);
+    }
+
+    std::array<uint32_t, 4> operator()(const uint32_t index, const uint32_t frame, const uint32_t stream) const {
+        std::array<uint32_t, 4> counter = {index, frame, stream, 0};
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+            const uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+            counter = {
+                static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ k0,
+                static_cast<uint32_t>(product1),
+                static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ k1,
+                static_cast<uint32_t>(product0)
+            };
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return counter;
+    }
+};
+
+// Uniform float in [0, 1) from the top 24 bits
+inline float philoxUnit(const uint32_t bits) {
+    return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Uniform integer in [a, b] without the modulo bias
+inline int philoxRange(const uint32_t bits, const int a, const int b) {
+    return a + static_cast<int>(static_cast<uint64_t>(bits) * static_cast<uint32_t>(b - a + 1) >> 32);
+}
+
+#endif //PHILOX_H
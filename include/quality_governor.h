@@ -0,0 +1,68 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+#include <clock.h>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Frames averaged into one judgement of the frame time
+#define QUALITY_WINDOW_FRAMES 30
+// Share of the budget a window has to exceed, this many windows in a row, before quality drops a step
+#define QUALITY_DOWN_THRESHOLD 0.9f
+#define QUALITY_DOWN_WINDOWS 2
+// Share of the budget a window has to stay under before quality climbs a step, the windows needed
+// double every time a climb is undone straight away so the governor settles instead of oscillating
+#define QUALITY_UP_THRESHOLD 0.6f
+#define QUALITY_UP_WINDOWS 4
+#define QUALITY_MAX_UP_WINDOWS 64
+// GPU timer queries in flight, results are read a few frames late instead of stalling on them
+#define QUALITY_GPU_QUERIES 4
+
+// One rung of the quality ladder
+struct qualityLevel {
+    float dropScale;        // Share of the raindrops simulated and drawn
+    int antialiasSamples;
+    bool blur;              // Ghosting blur, the blur pass and the bloom
+    float resolutionScale;  // Framebuffer size relative to the window
+};
+
+// Watches CPU and GPU frame time against a budget and walks the quality ladder one rung at a time
+class QualityGovernor {
+public:
+    void initialize(float budget);
+    void destroy();
+
+    // Bracket everything a frame renders, frameEnd returns true when the level changed
+    void frameBegin();
+    bool frameEnd();
+
+    const qualityLevel &level() const;
+    int levelIndex() const { return current; }
+    // Rung of the ladder by index, clamped to the ends
+    static const qualityLevel &ladderLevel(int index);
+
+private:
+    void collectGpuTimes();
+    void changeLevel(int direction, const char *reason, double cpu, double gpu);
+
+    float budget = 0.0f;
+    int current = 0;
+    chrono_impl::steady_clock::time_point frameStart{};
+    double cpuTime = 0.0, gpuTime = 0.0;
+    int windowFrames = 0, gpuFrames = 0;
+    int downWindows = 0, upWindows = 0;
+    int upWindowsNeeded = QUALITY_UP_WINDOWS;
+    int windowsSinceClimb = QUALITY_MAX_UP_WINDOWS;
+    bool settling = false;
+#ifndef __ANDROID__
+    GLuint queries[QUALITY_GPU_QUERIES]{};
+    bool queryPending[QUALITY_GPU_QUERIES]{};
+    int nextQuery = 0;
+    bool queryActive = false;
+#endif
+};
+
+#endif //QUALITY_GOVERNOR_H
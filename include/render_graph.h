@@ -0,0 +1,136 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Frames a cached target may go unused before it is freed
+#define RENDER_GRAPH_IDLE_FRAMES 120
+
+// Targets with the same description can stand in for each other
+struct renderTargetDesc {
+    int samples = 1;  // More than one is only drawn into, a pass reading it gets a resolved copy
+    GLenum format = GL_RGBA8;
+    bool depthStencil = false;
+    int downscale = 0;  // Halves the graph's size this many times, for the levels of a blur pyramid
+
+    bool operator==(const renderTargetDesc &other) const {
+        return samples == other.samples && format == other.format && depthStencil == other.depthStencil &&
+               downscale == other.downscale;
+    }
+};
+
+struct renderTarget {
+    renderTargetDesc desc;
+    long width = 0;
+    long height = 0;
+    GLuint fbo{};
+    GLuint texture{};  // A renderbuffer for multisampled targets on GLES
+    GLuint depthStencil{};
+};
+
+void createRenderTarget(renderTarget &target, const renderTargetDesc &desc, long width, long height);
+void destroyRenderTarget(renderTarget &target);
+
+// Index of a resource declared for the current frame
+typedef int renderResource;
+
+class RenderGraph;
+typedef std::function<void(const RenderGraph &graph)> renderPassFunction;
+
+// Rebuilt every frame: passes declare the resources they sample and the one they draw into, compile()
+// culls the passes nothing consumes, inserts a resolve before the first read of a multisampled resource
+// and hands transient resources targets from a cache, sharing one target between resources whose
+// lifetimes don't overlap. Histories persist across frames and are only changed by retain().
+class RenderGraph {
+public:
+    // Drops every cached target and history, they are made again at the new size
+    void resize(long width, long height);
+    void destroy();
+
+    // Forgets the resources and passes of the last frame
+    void begin();
+    // A target owned by someone else, like the window or the scene the app draws into
+    renderResource import(const char *name, const renderTarget &target);
+    // Contents are undefined until a pass writes it, the target may be shared once its last reader ran
+    renderResource create(const char *name, const renderTargetDesc &desc);
+    // What retain() kept in an earlier frame, cleared when it is first made
+    renderResource history(const char *name, const renderTargetDesc &desc);
+    // Clears write and runs execute with its framebuffer bound
+    void addPass(const char *name, std::vector<renderResource> reads, renderResource write, renderPassFunction execute);
+    // Once the frame ran, the history takes over the target of resource without a copy
+    void retain(renderResource history, renderResource resource);
+
+    void compile();
+    void execute();
+
+    // The single sampled target holding resource, for passes to sample and for reading back
+    const renderTarget &target(renderResource resource) const;
+    GLuint texture(renderResource resource) const { return target(resource).texture; }
+    // The persistent target behind a history, for seeding it before the first frame
+    renderTarget &historyTarget(const char *name, const renderTargetDesc &desc);
+    // The history's target, nullptr until a frame or historyTarget() made it
+    const renderTarget *findHistory(const char *name) const;
+
+private:
+    enum resourceKind { IMPORTED, TRANSIENT, HISTORY };
+
+    struct resourceNode {
+        std::string name;
+        resourceKind kind;
+        renderTargetDesc desc;
+        renderTarget imported;
+        int physical = -1;  // Cached target, or the history for HISTORY
+        renderResource resolved = -1;  // Single sampled copy of a multisampled resource
+        int firstStep = -1;
+        int lastStep = -1;
+    };
+
+    struct passNode {
+        std::string name;
+        std::vector<renderResource> reads;
+        renderResource write;
+        renderPassFunction execute;
+    };
+
+    // A pass, or a resolve of its only read into write when pass is -1
+    struct stepNode {
+        int pass;
+        std::vector<renderResource> reads;
+        renderResource write;
+        bool live;
+    };
+
+    struct cachedTarget {
+        renderTarget target;
+        bool used;
+        long lastFrame;
+    };
+
+    struct historyNode {
+        std::string name;
+        renderTarget target;
+    };
+
+    const renderTarget &physicalTarget(renderResource resource) const;
+    renderResource resolve(renderResource resource, std::vector<bool> &resolvedValid);
+    int acquire(const renderTargetDesc &desc);
+
+    long width = 0;
+    long height = 0;
+    long frame = 0;
+    std::vector<resourceNode> resources;
+    std::vector<passNode> passes;
+    std::vector<std::pair<renderResource, renderResource>> retained;
+    std::vector<stepNode> steps;
+    std::vector<cachedTarget> cache;
+    std::vector<historyNode> histories;
+};
+
+#endif //RENDER_GRAPH_H
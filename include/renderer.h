@@ -6,6 +6,11 @@
 #include <events.h>
 #include <iostream>
 #include <shader.h>
+#include <quality_governor.h>
+#include <gpu_timer.h>
+#include <event_log.h>
+#include <checkpoint.h>
+#include <render_graph.h>
 
 #ifdef __ANDROID__
 #include <EGL/egl.h>
@@ -27,6 +32,13 @@
 
 #define TITLE "Matrix rain"
 
+// Blurs at least this wide run as a dual filter pyramid, every level doubles the reach of the one above
+#define BLUR_PYRAMID_MIN_SIZE 2.0f
+#define BLUR_PYRAMID_MAX_LEVELS 6
+// The bloom pyramid goes down to 1/32 of the frame and back up to half of it, where the present pass adds it
+#define BLOOM_LEVELS 5
+#define BLOOM_STRENGTH 1.0f
+
 #if defined(__linux__) && !defined(__ANDROID__)
 typedef GLXContext (*glXCreateContextAttribsARBProc)(Display *, GLXFBConfig, GLXContext, Bool, const int *);
 #endif
@@ -74,32 +86,50 @@ struct renderer {
     int antialiasSamples = 4;
     App *app = nullptr;
     tickRateClock *clock;
+    // Set by the governor, the framebuffers are rendered at renderWidth x renderHeight and scaled to the window
+    QualityGovernor *governor = nullptr;
+    qualityLevel quality = {1.0f, 4, true, 1.0f};
+    int qualityIndex = 0;
+    // --record writes every rendered frame out, --replay feeds them back instead of the platform events
+    EventRecorder *recorder = nullptr;
+    EventReplayer *replayer = nullptr;
+    // Only open while the app and the renderer restore from it during initialize
+    CheckpointReader *checkpoint = nullptr;
+    CheckpointWriter *checkpointWriter = nullptr;
+    double lastCheckpointTime = 0.0;
+    // The periodic checkpoint copies what lives on the GPU into buffers and commits it a frame or two later, once
+    // checkpointFence has passed. The ghosting history is read back into a pixel buffer, accumulated ghosting is
+    // resolved into checkpointResolve first
+    GLsync checkpointFence{};
+#ifndef __ANDROID__
+    GLuint checkpointPixelBuffer{};
+    int32_t checkpointSize[2]{};
+    renderTarget checkpointResolve{};
+#endif
+    long renderWidth = 0;
+    long renderHeight = 0;
 #ifndef __ANDROID__
     GLFWwindow *glfwWindow = nullptr;
 #endif
 
-    ShaderProgram *ppGhostingProgram{};
-    ShaderProgram *ppBlurProgram{};
+    // A variant of the post-processing shader for every combination of PostProcessingOptions stages
+    ShaderProgram *ppPrograms[(GHOSTING | BLUR | BLOOM) + 1]{};
+    // The dual filter pyramids, the first downsample can have the ghosting stage fused into it and an upsample
+    // can add the bloom
+    ShaderProgram *ppDownsamplePrograms[GHOSTING + 1]{};
+    ShaderProgram *ppUpsamplePrograms[BLOOM + 1]{};
+    ShaderProgram *ppBrightPassProgram{};
 
     ShaderProgram *ppFinalProgram{};
+    ShaderProgram *ppFadeProgram{};
 
     GLuint ppFullQuadArray{};
     GLuint ppFullQuadBuffer{};
 
-    GLuint fboC{};
-    GLuint fboCTexture{};
-    GLuint fboM{};
-    GLuint fboMTexture{};
-    GLuint fboP{};
-    GLuint fboPTexture{};
-
-    GLuint fboCOutput{};
-    GLuint fboCTextureOutput{};
-    GLuint fboMOutput{};
-    GLuint fboMTextureOutput{};
-    GLuint fboPOutput{};
-    GLuint fboPTextureOutput{};
-    GLuint RBO{};
+    // The app draws into the multisampled scene, the post-processing passes are declared to the graph every frame
+    renderTarget scene{};
+    RenderGraph graph;
+    GpuTimer bloomTimer;
 
     void makeWindow();
 
@@ -112,16 +142,34 @@ struct renderer {
     void frameBegin() const;
 
     static void clear();
+    void fadeFrame() const;
+
+    renderPassFunction postProcessingPass(const ShaderProgram *program, uint8_t stages, renderResource current,
+                                          renderResource history, renderResource bloom, GLfloat blurSize,
+                                          GLfloat bloomStrength);
+    void addPostProcessingPass(const char *name, const ShaderProgram *program, uint8_t stages, renderResource current,
+                               renderResource history, renderResource bloom, renderResource write, GLfloat blurSize,
+                               GLfloat bloomStrength);
+    // Fuses the stages into one pass, a blur of at least BLUR_PYRAMID_MIN_SIZE becomes a dual filter pyramid
+    void addPostProcessingPasses(const char *name, uint8_t stages, renderResource current, renderResource history,
+                                 renderResource bloom, renderResource write, GLfloat blurSize);
+    // The half size bloom of what is brighter than white in frame
+    renderResource addBloomPasses(renderResource frame);
 
-    void _swapPPBuffersCM();
-
-    void _swapPPBuffersPM();
+    void frameEnd();
 
-    void _resolveMultisampledFramebuffer(GLuint srcFbo, GLuint dstFbo) const;
+    void governFrame();
 
-    void _sampleFrameBuffersForPostProcessing() const;
+    void applyQuality(const qualityLevel &level);
 
-    void frameEnd();
+    void restoreCheckpoint() const;
+    // Blocks until the whole checkpoint is read back, only for the last one at shutdown
+    void saveCheckpoint();
+    // Reads the history and the app's GPU state back asynchronously, finishCheckpoint commits them once they arrived
+    void startCheckpoint();
+    void finishCheckpoint(bool wait);
+    void addCheckpointSections() const;
+    const renderTarget *checkpointHistory();
 
     groupedEvents *events = nullptr;
 
@@ -132,14 +180,14 @@ struct renderer {
     void makeContext();
 
     void makeFrameBuffers();
-    void createFrameBufferTexture(GLuint &fbo, GLuint &fboTexture, GLuint format, bool multiSampled) const;
+    void destroyFrameBuffers();
 
     void initializePP();
 
     void initialize();
 
     void swapBuffers();
-    void destroy() const;
+    void destroy();
 };
 
 #endif //RENDERER_H
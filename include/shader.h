@@ -30,10 +30,14 @@ public:
     GLuint getUniformLocation(const GLchar *name) const;
     GLuint getUniformBlockIndex(const GLchar *name) const;
     void uniformBlockBinding(GLuint blockIndex, GLuint blockBinding) const;
+    // Must be called before linkProgram, outputs are captured interleaved in the given order
+    void transformFeedbackVaryings(const GLchar *const *varyings, GLsizei count) const;
 
     // Load individual shader types
     void loadShader(const unsigned char *source, int length, GLuint type);
     void loadShader(const char *source, GLuint type);
+    // Compiles a variant, the defines go right after the #version line
+    void loadShader(const unsigned char *source, int length, GLuint type, const std::string &defines);
 
     // Parse vertex and fragment shaders from a single source
     void loadShader(const unsigned char *source, int length);
@@ -0,0 +1,47 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+#include <vector>
+
+#ifdef __ANDROID__
+#include <GLES3/gl3.h>
+#else
+#include "glad.h"
+#endif
+
+// Frames of data in flight before a write has to wait on the GPU
+#define STREAMING_BUFFER_SEGMENTS 3
+// Segment starts are aligned so the same buffer can back uniform blocks
+#define STREAMING_BUFFER_ALIGNMENT 256
+
+// Ring of per-frame segments in one buffer object. Each frame writes the next segment while the GPU
+// may still be reading the older ones, a fence per segment keeps writes from overtaking draws.
+// Maps persistently when ARB_buffer_storage is available, otherwise maps each segment unsynchronized.
+class StreamingBuffer {
+public:
+    void create(GLenum target, GLsizeiptr segmentSize, int segments = STREAMING_BUFFER_SEGMENTS);
+    void destroy();
+
+    // Waits until the next segment is free and returns it for writing
+    void *map();
+    // Finishes the write, returns the byte offset of the segment in buffer()
+    GLintptr unmap();
+    // Call once the draws reading the current segment are submitted, may be repeated when it is drawn again
+    void fence();
+
+    GLuint buffer() const { return handle; }
+    bool persistent() const { return mapped != nullptr; }
+
+    // Seconds map() spent waiting on the GPU, for the last frame and in total
+    double stallTime = 0.0;
+    double totalStallTime = 0.0;
+
+private:
+    GLenum target{};
+    GLuint handle{};
+    GLsizeiptr segmentSize{};
+    int segment = 0;
+    std::vector<GLsync> fences;
+    unsigned char *mapped = nullptr;
+};
+
+#endif //STREAMING_BUFFER_H
@@ -1,10 +1,17 @@
 #include "apps/matrix.h"
+#include <font_atlas_builder.h>
 #include <fonts.h>
 #include <gl_errors.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cmath>
+#include <cstring>
+#include <random>
+#include <unordered_set>
 
 #include "helper.h"
 #include "matrix_font.h"
@@ -13,18 +20,87 @@
 #include "stb_image.h"
 
 
+// Everything in a RainStore that outlives a tick, 4 bytes per raindrop each, the rest is rolled again every tick
+static std::array<void *, 8> persistentRainArrays(const RainStore &rain) {
+    return {rain.x, rain.y, rain.speed, rain.pushX, rain.pushY, rain.colorOffset, rain.pardons, rain.spark};
+}
+
 void MatrixApp::setup() {
-    // Enable post-processing with framerate-independent ghosting
-    rnd->opts->postProcessingOptions |= GHOSTING;
+    // Enable post-processing with framerate-independent ghosting, unless the trails are drawn as glyphs
+    if (rnd->opts->trails > 0) {
+        trailSlots = std::min(rnd->opts->trails, MATRIX_MAX_TRAIL) + 1;
+    } else {
+        rnd->opts->postProcessingOptions |= GHOSTING;
+    }
 #ifdef __ANDROID__
-    rnd->opts->ghostingPreviousFrameOpacity = 0.97f;
+    // The window is faded 8% every frame at 60 FPS
+    rnd->opts->ghostingPreviousFrameOpacity = 0.92f;
 #else
     rnd->opts->ghostingPreviousFrameOpacity = 0.997f;
 #endif
     rnd->opts->ghostingBlurSize = 0.1f;
+    // Sparks glow when --bloom allows it
+    rnd->opts->postProcessingOptions |= BLOOM;
 
-    // Handle font initialization
-    atlas = createFontTextureAtlas(matrixFont, &matrixFontInfo);
+    fallUp = rnd->opts->rainUp;
+    debugLayout = rnd->opts->debugLayout;
+    // Touches scroll the Android wallpaper, they never push the rain
+#ifdef __ANDROID__
+    cursorPush = false;
+#else
+    cursorPush = rnd->opts->interaction;
+#endif
+    rot_d15 = static_cast<float>(rnd->opts->rotation) / 15.0f;
+    rot_d15_m2 = rot_d15 * 2;
+    rot_d15_d2 = rot_d15 / 2;
+
+    // Handle font initialization, a font given at runtime is rasterized at the size the glyphs are drawn at. The
+    // distance field scales the glyphs itself, it gets them as large as the embedded ones
+    GlyphSource *glyphSource = nullptr;
+    if (rnd->opts->fontPath.has_value()) {
+        const int fontSize = rnd->opts->distanceFieldGlyphs
+            ? matrixFontInfo.size
+            : static_cast<int>(std::lround(static_cast<float>(rnd->opts->height) / (debugLayout ? 20.0f : 70.0f)));
+        glyphSource = createGlyphSource(rnd->opts->fontPath.value(), fontSize, rnd->opts->distanceFieldGlyphs);
+    }
+    if (glyphSource == nullptr) {
+        glyphSource = createGlyphSource(matrixFont, &matrixFontInfo, rnd->opts->distanceFieldGlyphs);
+    }
+    glyphCache = new GlyphCache();
+    glyphCache->create(glyphSource);
+
+    charsets.clear();
+    for (const std::string &name : rnd->opts->charsets) {
+        charsets.emplace_back();
+        findCharset(name, charsets.back());
+    }
+    if (rnd->opts->charsetText.has_value()) {
+        charsets.push_back(decodeUtf8(rnd->opts->charsetText.value()));
+    }
+    if (charsets.size() > 1 && rnd->opts->charsetTime > 0.0f) {
+        // All of them are rasterized now when they fit, so switching never waits on the font. Otherwise a switch
+        // fills the cache over a few frames while the last charset is still drawn, so each gets half of it
+        std::unordered_set<uint32_t> characters;
+        for (const std::vector<uint32_t> &charset : charsets) {
+            characters.insert(charset.begin(), charset.end());
+        }
+        if (characters.size() <= glyphCache->capacity()) {
+            for (size_t i = charsets.size() - 1; i > 0; --i) {
+                glyphCache->setCharset(charsets[i]);
+            }
+        } else {
+            for (std::vector<uint32_t> &charset : charsets) {
+                charset.resize(std::min(charset.size(), glyphCache->capacity() / 2));
+            }
+        }
+    }
+    activeCharset = 0;
+    if (!glyphCache->setCharset(charsets[0])) {
+        // The embedded characters are in every font this can load
+        std::cerr << "None of the characters of the first charset are in the font, using the matrix ones" << std::endl;
+        findCharset("matrix", charsets[0]);
+        glyphCache->setCharset(charsets[0]);
+    }
 
 #ifdef __ANDROID__
     int rainLimit = 500;  // Reduced for mobile performance
@@ -34,8 +110,9 @@ void MatrixApp::setup() {
 
 
     // Calculate character scale and mouse radius
-    float characterScale = static_cast<float>(rnd->opts->height) / (MATRIX_DEBUG ? 20.0 : 70.0) / static_cast<float>(matrixFontInfo.size);
+    float characterScale = static_cast<float>(rnd->opts->height) / (debugLayout ? 20.0 : 70.0) / static_cast<float>(glyphCache->size);
     mouseRadius = rnd->opts->height / 10.0f;
+    glyphSize = characterScale * static_cast<float>(glyphCache->size);
 
 
     // Handle program initialization
@@ -55,27 +132,88 @@ void MatrixApp::setup() {
 
     // Get uniform locations
     GL_CHECK(glUniform1i(program->getUniformLocation("u_AtlasTexture"), 0));
-    GL_CHECK(glUniform1i(program->getUniformLocation("u_MaxCharacters"), matrixFontInfo.characterCount-1));
-    GL_CHECK(glUniform1i(program->getUniformLocation("u_Rotation"), MATRIX_ROTATION));
+    GL_CHECK(glUniform1i(program->getUniformLocation("u_GlyphTable"), GLYPH_TABLE_TEXTURE_UNIT));
+    ui_MaxCharacters = program->getUniformLocation("u_MaxCharacters");
+    GL_CHECK(glUniform1i(ui_MaxCharacters, std::max(1, static_cast<int>(glyphCache->glyphs.size()) - 1)));
+    GL_CHECK(glUniform1i(program->getUniformLocation("u_Rotation"), rnd->opts->rotation));
     GL_CHECK(glUniform1f(program->getUniformLocation("u_CharacterScaling"), characterScale));
-    GL_CHECK(glUniform2f(program->getUniformLocation("u_AtlasTextureSize"), atlas->atlasWidth, atlas->atlasHeight));
+    GL_CHECK(glUniform2f(program->getUniformLocation("u_AtlasTextureSize"), static_cast<float>(glyphCache->pageSize),
+        static_cast<float>(glyphCache->pageSize)));
+    GL_CHECK(glUniform1i(program->getUniformLocation("u_DistanceField"), glyphCache->distanceField));
     GL_CHECK(glUniform2f(program->getUniformLocation("u_ViewportSize"),
     static_cast<float>(rnd->opts->width),
     static_cast<float>(rnd->opts->height)));
 
-    const GLuint blockIndex = program->getUniformBlockIndex("u_AtlasBuffer");
-    program->uniformBlockBinding(blockIndex, 0);
-
     glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(rnd->opts->width), 0.0f,
                                       static_cast<float>(rnd->opts->height));
     GL_CHECK(glUniformMatrix4fv(program->getUniformLocation("u_Projection"), 1, GL_FALSE, glm::value_ptr(projection)));
+    GL_CHECK(glUniform1f(program->getUniformLocation("u_SparkBrightness"),
+        rnd->opts->userAllowedPostProcessingOptions & BLOOM ? MATRIX_SPARK_BLOOM_BRIGHTNESS : 1.0f));
 
     ui_BaseColor = program->getUniformLocation("u_BaseColor");
     ui_Time = program->getUniformLocation("u_Time");
+    ui_TickAlpha = program->getUniformLocation("u_TickAlpha");
+    ui_TrailSlots = program->getUniformLocation("u_TrailSlots");
+    ui_TrailHead = program->getUniformLocation("u_TrailHead");
+    ui_TrailStamps = program->getUniformLocation("u_TrailStamps");
+    ui_TrailActive = program->getUniformLocation("u_TrailActive");
+    ui_History = program->getUniformLocation("u_History");
+    ui_Motion = program->getUniformLocation("u_Motion");
+    ui_MotionTime = program->getUniformLocation("u_MotionTime");
+    GL_CHECK(glUniform1i(ui_TrailSlots, 0));
+    GL_CHECK(glUniform1i(ui_History, 0));
+    GL_CHECK(glUniform1i(ui_Motion, 0));
+
+    if (rnd->opts->drops.has_value()) {
+        rainLimit = std::max(1, rnd->opts->drops.value());
+    }
 
     // Handle vertex buffer initialization
-    rainDrawData.resize(rainLimit);
-    rainData.resize(rainLimit);
+    rain.allocate(rainLimit);
+    // Cells as wide as the cursor radius, so a cursor only ever overlaps 3x3 of them
+    grid.resize(static_cast<float>(rnd->opts->width), static_cast<float>(rnd->opts->height), mouseRadius, rainLimit);
+    const matrixCheckpoint *saved = findCheckpoint(rainLimit);
+
+    unsigned features = 0u;
+    if (fallUp) {
+        features |= static_cast<unsigned>(RAIN_FEATURE_FALL_UP);
+    }
+    if (cursorPush) {
+        features |= static_cast<unsigned>(RAIN_FEATURE_INTERACTIVE);
+    }
+    if (debugLayout) {
+        features |= static_cast<unsigned>(RAIN_FEATURE_STATIC);
+    }
+    rainKernel = selectRainKernel(features);
+
+    // Only spin up workers when there is more than one chunk and more than one core to spread it over
+    const int chunks = (rainLimit + MATRIX_RAIN_CHUNK - 1) / MATRIX_RAIN_CHUNK;
+    chunkCursorPardons.resize(chunks);
+    chunkMovedDrops.resize(chunks);
+    if (chunks > 1 && !rnd->opts->gpuRain) {
+        jobs = new JobPool(rnd->opts->threads);
+        if (jobs->threadCount() <= 1) {
+            delete jobs;
+            jobs = nullptr;
+        }
+    }
+
+    const uint64_t seed = saved != nullptr ? saved->seed :
+        rnd->opts->seed.value_or(static_cast<uint64_t>(std::random_device{}()) << 32 | std::random_device{}());
+    random = Philox4x32(seed);
+    // Kept so --record can store it
+    rnd->opts->seed = seed;
+    rainFrame = 0;
+    // Start a full tick in so the first frame always has one to draw
+    tickLength = rnd->opts->simRate > 0 ? 1.0f / static_cast<float>(rnd->opts->simRate) : 0.0f;
+    tickAccumulator = tickLength;
+    if (saved != nullptr) {
+        // The counters carry on, so the rain continues exactly as it would have
+        rainFrame = saved->rainFrame;
+        tickAccumulator = saved->tickAccumulator;
+        baseColor = saved->baseColor;
+        activeCursorPardons = saved->activeCursorPardons;
+    }
 
     GL_CHECK(glGenVertexArrays(1, &vertexArray));
     GL_CHECK(glBindVertexArray(vertexArray));
@@ -103,44 +241,40 @@ void MatrixApp::setup() {
     GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
 #endif
 
-    // Instance data buffer
-    GL_CHECK(glGenBuffers(1, &vertexBuffer));
-    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
-    GL_CHECK(
-        glBufferData(GL_ARRAY_BUFFER, rainDrawData.capacity() * sizeof(RainDrawData), nullptr,
-            GL_STREAM_DRAW));
-
-    GL_CHECK(glVertexAttribPointer(
-        0,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(RainDrawData),
-        nullptr
-    ));
+    // The GPU simulation never uploads instances, so only the CPU path has anything to pack
+    analyticRain = rnd->opts->analyticRain;
+    compactInstances = rnd->opts->compactInstances && !rnd->opts->gpuRain && !analyticRain;
+    instanceStride = compactInstances ? sizeof(RainCompactData) : sizeof(RainDrawData);
+    velocityStride = compactInstances ? sizeof(int16_t) : sizeof(float);
+    // Every segment has room for the particles after the raindrops
+    particles.allocate(MATRIX_PARTICLES);
+    instanceSlots = rainLimit + MATRIX_PARTICLES;
+    lastCursorX = static_cast<float>(rnd->events->mouseX);
+    lastCursorY = static_cast<float>(rnd->opts->height - rnd->events->mouseY);
+    if (compactInstances) {
+        // The kernels keep writing floats, into these, and the packed copy is what gets uploaded
+        stagingInstances.resize(instanceSlots);
+        stagingVelocity.resize(2 * static_cast<size_t>(instanceSlots));
+    }
+    GL_CHECK(glUniform1f(program->getUniformLocation("u_PositionScale"), compactInstances ? 1.0f / MATRIX_RAIN_FIXED_SCALE : 1.0f));
+    GL_CHECK(glUniform1f(program->getUniformLocation("u_VelocityScale"), compactInstances ? 1.0f / MATRIX_RAIN_VELOCITY_SCALE : 1.0f));
+
+    // Instance data is streamed through a ring so a frame never waits on the draw before it,
+    // each segment holds the interleaved instances followed by the x and y velocity arrays
+    instances.create(GL_ARRAY_BUFFER, instanceSlots * (instanceStride + 2 * velocityStride));
+    bindInstanceAttributes(instances.buffer(), instanceStride, 0);
+    bindVelocityAttributes(instances.buffer(), velocityStride, 0, 0);
     GL_CHECK(glEnableVertexAttribArray(0));
-    GL_CHECK(glVertexAttribPointer(
-        1,
-        1,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(RainDrawData),
-        reinterpret_cast<void *>(2 * sizeof(float))
-    ));
     GL_CHECK(glEnableVertexAttribArray(1));
-    GL_CHECK(glVertexAttribPointer(
-        2,
-        1,
-        GL_INT,
-        GL_FALSE,
-        sizeof(RainDrawData),
-        reinterpret_cast<void *>(3 * sizeof(float))
-    ));
     GL_CHECK(glEnableVertexAttribArray(2));
+    GL_CHECK(glEnableVertexAttribArray(4));
+    GL_CHECK(glEnableVertexAttribArray(5));
 
     GL_CHECK(glVertexAttribDivisor(0, 1));
     GL_CHECK(glVertexAttribDivisor(1, 1));
     GL_CHECK(glVertexAttribDivisor(2, 1));
+    GL_CHECK(glVertexAttribDivisor(4, 1));
+    GL_CHECK(glVertexAttribDivisor(5, 1));
 
 #ifdef __ANDROID__
     // Re-bind the quad buffer to attribute 3 to ensure it's set correctly
@@ -149,24 +283,98 @@ void MatrixApp::setup() {
     GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
 #endif
 
-    // Initialize vertices
-    for (int i = 0; i < rainData.capacity(); ++i) {
-        if constexpr (MATRIX_DEBUG) {
-            rainDrawData[i].x = matrixFontInfo.characterInfoList[i].xOffset * characterScale;
-            rainDrawData[i].y = matrixFontInfo.characterInfoList[i].yOffset * characterScale;
-        } else {
-            rainDrawData[i].x = random_td_float(0, rnd->opts->width);
-            rainDrawData[i].y = random_td_float(0, rnd->opts->height);
+    if (trailSlots > 0) {
+        // Slots are copied whole from whatever the raindrops are drawn from, so they share its layout
+        trailStride = rnd->opts->gpuRain ? sizeof(GpuRainState) : analyticRain ? sizeof(RainMotionData) : instanceStride;
+        trailHead = 0;
+        std::fill(std::begin(trailStamps), std::end(trailStamps), -1.0f);
+        GL_CHECK(glUniform1i(program->getUniformLocation("u_TrailDrops"), rainLimit));
+
+        GL_CHECK(glGenBuffers(1, &trailBuffer));
+        GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, trailBuffer));
+        GL_CHECK(glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(trailSlots) * rainLimit * trailStride, nullptr, GL_DYNAMIC_COPY));
+
+        // History is never interpolated, so the velocity attributes stay disabled and read as zero,
+        // except for analytic motion where the shader moves each slot to the time it was recorded at
+        GL_CHECK(glGenVertexArrays(1, &trailVertexArray));
+        GL_CHECK(glBindVertexArray(trailVertexArray));
+        bindInstanceAttributes(trailBuffer, trailStride, 0);
+        GL_CHECK(glEnableVertexAttribArray(0));
+        GL_CHECK(glEnableVertexAttribArray(1));
+        GL_CHECK(glEnableVertexAttribArray(2));
+        GL_CHECK(glVertexAttribDivisor(0, 1));
+        GL_CHECK(glVertexAttribDivisor(1, 1));
+        GL_CHECK(glVertexAttribDivisor(2, 1));
+        if (analyticRain) {
+            bindMotionAttributes(trailBuffer);
+            for (const GLuint attribute : {4u, 5u, 7u}) {
+                GL_CHECK(glEnableVertexAttribArray(attribute));
+                GL_CHECK(glVertexAttribDivisor(attribute, 1));
+            }
+        }
+#ifdef __ANDROID__
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, quadVertexBuffer));
+        GL_CHECK(glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, nullptr));
+        GL_CHECK(glEnableVertexAttribArray(3));
+        GL_CHECK(glVertexAttribDivisor(3, 0));
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+#endif
+        GL_CHECK(glBindVertexArray(vertexArray));
+        if (saved != nullptr) {
+            restoreTrail(*saved);
+        }
+    }
+
+    if (rnd->opts->gpuRain || analyticRain) {
+        // The raindrops are drawn from their own buffer here, the particles get a second draw from instances
+        GL_CHECK(glGenVertexArrays(1, &particleVertexArray));
+        GL_CHECK(glBindVertexArray(particleVertexArray));
+        for (const GLuint attribute : {0u, 1u, 2u, 4u, 5u}) {
+            GL_CHECK(glEnableVertexAttribArray(attribute));
+            GL_CHECK(glVertexAttribDivisor(attribute, 1));
+        }
+#ifdef __ANDROID__
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, quadVertexBuffer));
+        GL_CHECK(glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, nullptr));
+        GL_CHECK(glEnableVertexAttribArray(3));
+        GL_CHECK(glVertexAttribDivisor(3, 0));
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+#endif
+        GL_CHECK(glBindVertexArray(vertexArray));
+    }
+
+    // Initialize vertices, rain frame 0 is reserved for the initial placement
+    if (saved != nullptr) {
+        const auto *arrays = static_cast<const unsigned char *>(
+            rnd->checkpoint->section(checkpointTag("RAIN"), persistentRainArrays(rain).size() * rain.count * 4));
+        for (void *array : persistentRainArrays(rain)) {
+            memcpy(array, arrays, rain.count * 4);
+            arrays += rain.count * 4;
         }
-        rainDrawData[i].colorOffset = randomColorOffset();
-        rainDrawData[i].spark = randomSpark();
-        rainData[i].speed = randomSpeed();
-        if constexpr (MATRIX_DEBUG) {
-            rainData[i].speed = 0;
-        } else if constexpr (MATRIX_UP) {
-            rainData[i].speed *= -1;
+    }
+    for (int i = 0; i < rain.count && saved == nullptr; ++i) {
+        resetRain(i, rainFrame);
+        if (debugLayout) {
+            const CharacterInfo &character = glyphCache->glyphs[i % glyphCache->glyphs.size()].character;
+            rain.x[i] = character.xOffset * characterScale;
+            rain.y[i] = character.yOffset * characterScale;
+            rain.speed[i] = 0;
+        } else {
+            rain.y[i] = random_td_float(random(i, rainFrame, MATRIX_RANDOM_PLACE)[0], 0, rnd->opts->height);
         }
     }
+    // The placement is already spread like a running rain, only the trails behind it are missing
+    if (saved == nullptr && !debugLayout && rnd->opts->warmUp > 0.0f) {
+        fastForward(rnd->opts->warmUp);
+    }
+
+    if (rnd->opts->gpuRain) {
+        gpuRain = new GpuRain();
+        gpuRain->setup(rain, seed, static_cast<float>(rnd->opts->width), static_cast<float>(rnd->opts->height), rot_d15_m2, fallUp);
+    }
+    if (analyticRain) {
+        setupMotion();
+    }
 
     // Load and bind wallpaper texture if needed
     if (useWallPaperShader) {
@@ -187,13 +395,127 @@ void MatrixApp::setup() {
 }
 
 void MatrixApp::loop() {
+    int amountOfSpawnedParticles = std::max(0, static_cast<int>(rnd->events->keysPressed) * MATRIX_EFFECT_PER_KEYPRESS);
+    if (rnd->events->mouseLeft) {
+        amountOfSpawnedParticles += MATRIX_DRAW_STRENGTH;
+    }
+    if (!rnd->opts->interaction) {
+        amountOfSpawnedParticles = 0;
+    }
+
+    // Advance the rain in fixed ticks, the vertex shader interpolates from the previous tick to the latest one
+    float tick = tickLength;
+    int ticks = 1;
+    float tickAlpha = 1.0f;
+    if (tickLength > 0.0f) {
+        tickAccumulator += rnd->clock->deltaTime;
+        ticks = static_cast<int>(tickAccumulator / tickLength);
+        tickAccumulator -= static_cast<float>(ticks) * tickLength;
+        // Drop the backlog instead of falling further behind every frame
+        ticks = std::min(ticks, MATRIX_MAX_TICKS_PER_FRAME);
+        tickAlpha = tickAccumulator / tickLength;
+    } else {
+        tick = rnd->clock->deltaTime;
+    }
+    // A frame without a tick draws what the last tick wrote, so the governor's drop count only changes on a tick
+    if (ticks > 0) {
+        activeDrops = std::max(1, static_cast<int>(static_cast<float>(rain.count) * rnd->quality.dropScale));
+    }
+    spawnParticles(amountOfSpawnedParticles, tick);
+
+    RainFrame frame{};
+    frame.cursorRadius = mouseRadius;
+    frame.speedBias = rot_d15_d2;
+    frame.fall = tick * MATRIX_DELTA_MULTIPLIER;
+    frame.height = static_cast<float>(rnd->opts->height);
+    frame.cursors[0] = {static_cast<float>(rnd->events->mouseX), static_cast<float>(rnd->opts->height - rnd->events->mouseY)};
+    frame.cursorCount = cursorPush ? 1 : 0;
+    frame.fallUp = fallUp;
+    frame.fixup = fixupRain;
+    frame.context = this;
+
+    // Without a tick this frame the previous one is drawn again further along
+    GL_CHECK(glBindVertexArray(vertexArray));
+    const double now = rnd->clock->elapsedTime;
+    if (analyticRain) {
+        // Nothing moves on the CPU, a raindrop is only rewritten when it changes course
+        for (int i = 0; i < ticks; ++i) {
+            beginTick(frame);
+        }
+        advanceMotion(now);
+        // One cursor pass per frame that ticked, the pushed raindrops start a new stretch from where it moved them
+        if (ticks > 0 && frame.cursorCount > 0) {
+            pushMotion(frame, now);
+        }
+        if (now - motionEpoch > MATRIX_MOTION_REBASE) {
+            rebaseMotion(now);
+        }
+        uploadMotion();
+        if (trailSlots > 0 && ticks > 0) {
+            recordTrail(motionBuffer, 0);
+        }
+        if (ticks > 0) {
+            streamParticles();
+        }
+    } else if (gpuRain != nullptr && ticks > 0) {
+        // The state never leaves the GPU, draw straight from the buffer the update wrote
+        for (int i = 0; i < ticks; ++i) {
+            beginTick(frame);
+            gpuRain->update(frame, rainFrame, activeDrops);
+        }
+        GL_CHECK(glBindVertexArray(vertexArray));
+        bindInstanceAttributes(gpuRain->stateBuffer(), sizeof(GpuRainState), 0);
+        bindVelocityAttributes(gpuRain->stateBuffer(), sizeof(GpuRainState),
+            offsetof(GpuRainState, velocityX), offsetof(GpuRainState, velocityY));
+        if (trailSlots > 0) {
+            recordTrail(gpuRain->stateBuffer(), 0);
+        }
+        streamParticles();
+    } else if (gpuRain == nullptr && ticks > 0) {
+        // The kernels write straight into the mapped segment, only the last tick is drawn
+        auto *segment = static_cast<unsigned char *>(instances.map());
+        const GLintptr velocityXOffset = instanceSlots * instanceStride;
+        const GLintptr velocityYOffset = velocityXOffset + instanceSlots * velocityStride;
+        const RainOutput out = compactInstances ?
+            RainOutput{stagingInstances.data(), stagingVelocity.data(), stagingVelocity.data() + instanceSlots} :
+            RainOutput{reinterpret_cast<RainDrawData *>(segment),
+                       reinterpret_cast<float *>(segment + velocityXOffset),
+                       reinterpret_cast<float *>(segment + velocityYOffset)};
+        for (int i = 0; i < ticks; ++i) {
+            beginTick(frame);
+            updateRain(frame, out);
+        }
+        // Straight after the active raindrops, so the one draw below covers both
+        particles.write(out, activeDrops);
+        drawnParticles = particles.live();
+        if (compactInstances) {
+            packInstances(out, segment, velocityXOffset, velocityYOffset);
+        }
+        const GLintptr offset = instances.unmap();
+        bindInstanceAttributes(instances.buffer(), instanceStride, offset);
+        bindVelocityAttributes(instances.buffer(), velocityStride, offset + velocityXOffset, offset + velocityYOffset);
+        if (trailSlots > 0) {
+            recordTrail(instances.buffer(), offset);
+        }
+    }
+
     program->useProgram();
 
+    // Charsets take turns on the clock, so a replay switches on the same frames
+    if (charsets.size() > 1 && rnd->opts->charsetTime > 0.0f) {
+        const size_t charset = static_cast<size_t>(now / rnd->opts->charsetTime) % charsets.size();
+        if (charset != activeCharset) {
+            activeCharset = charset;
+            glyphCache->requestCharset(charsets[charset]);
+        }
+    }
+    // The glyphs of a switch are rasterized a few at a time, the last charset is drawn until they are all in
+    if (glyphCache->update()) {
+        GL_CHECK(glUniform1i(ui_MaxCharacters, std::max(1, static_cast<int>(glyphCache->glyphs.size()) - 1)));
+    }
 
-    // Bind glyph buffer and texture
-    GL_CHECK(glActiveTexture(GL_TEXTURE0));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, atlas->glyphTexture));
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, atlas->glyphBuffer);
+    // Bind glyph table and pages
+    glyphCache->bind();
 
     if (useWallPaperShader) {
         GL_CHECK(glActiveTexture(GL_TEXTURE1));
@@ -202,172 +524,812 @@ void MatrixApp::loop() {
 
     GL_CHECK(glUniform1f(ui_BaseColor, baseColor));
     GL_CHECK(glUniform1f(ui_Time, rnd->clock->floatTime()));
+    GL_CHECK(glUniform1f(ui_TickAlpha, tickAlpha));
+    if (analyticRain) {
+        GL_CHECK(glUniform1f(ui_MotionTime, static_cast<float>(now - motionEpoch)));
+    }
 
     baseColor += rnd->clock->deltaTime / MATRIX_DELTA_MULTIPLIER;
 
-    int amountOfReassignedRaindrops = std::max(0, static_cast<int>(rnd->events->keysPressed) * MATRIX_EFFECT_PER_KEYPRESS);
-    if (rnd->events->mouseLeft) {
-        amountOfReassignedRaindrops += MATRIX_DRAW_STRENGTH;
+    // Render, the trail goes first so the raindrops land on top of it
+    if (trailSlots > 0) {
+        drawTrail();
+    }
+    if (particleVertexArray == 0) {
+        GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, activeDrops + drawnParticles));
+        instances.fence();
+    } else {
+        GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, activeDrops));
+        if (drawnParticles > 0) {
+            // Particles are ticked like the CPU rain, never moved analytically
+            GL_CHECK(glUniform1i(ui_Motion, 0));
+            GL_CHECK(glBindVertexArray(particleVertexArray));
+            GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, drawnParticles));
+            GL_CHECK(glBindVertexArray(vertexArray));
+            GL_CHECK(glUniform1i(ui_Motion, analyticRain ? 1 : 0));
+            instances.fence();
+        }
     }
 
-    if (amountOfReassignedRaindrops > rainData.capacity() - activeCursorPardons) {
-        amountOfReassignedRaindrops = rainData.capacity() - activeCursorPardons;
+    // rnd->fboPTextureOutput = atlas->glyphTexture;
+}
+
+void MatrixApp::addCheckpointState(CheckpointWriter &writer) {
+    if (analyticRain) {
+        // Brings rain.x and rain.y from where each stretch started to where the raindrops are now
+        rebaseMotion(rnd->clock->elapsedTime);
+        uploadMotion();
     }
+    const matrixCheckpoint header = {
+        rain.count, static_cast<int32_t>(rnd->opts->width), static_cast<int32_t>(rnd->opts->height),
+        trailSlots, trailStride, trailHead, rnd->opts->seed.value(), rainFrame, activeCursorPardons, baseColor, tickAccumulator
+    };
+    writer.add(checkpointTag("MTRX"), &header, sizeof(header));
+    if (trailSlots > 0) {
+        writer.add(checkpointTag("TRST"), trailStamps, trailSlots * sizeof(float));
+    }
+}
 
-    const int reassignedRaindrop = amountOfReassignedRaindrops > 0 ? random_int(0, rainData.capacity() - 1) : -1;
+void MatrixApp::addCheckpointRain(CheckpointWriter &writer) const {
+    auto *arrays = static_cast<unsigned char *>(writer.add(checkpointTag("RAIN"), persistentRainArrays(rain).size() * rain.count * 4));
+    for (const void *array : persistentRainArrays(rain)) {
+        memcpy(arrays, array, rain.count * 4);
+        arrays += rain.count * 4;
+    }
+}
 
-    // Update all rain drops every frame (essential for animation and ghosting trails)
-    activeCursorPardons = 0;
-    for (int i = 0; i < rainData.capacity(); ++i) {
-        incrementRain(i, i == reassignedRaindrop);
-        if (rainData[i].cursorPardons > 0) {
-            activeCursorPardons++;
+void MatrixApp::saveCheckpoint(CheckpointWriter &writer) {
+    // The shutdown save, waiting on the GPU doesn't matter anymore
+    if (gpuRain != nullptr) {
+        gpuRain->readBack(rain);
+    }
+    addCheckpointState(writer);
+    addCheckpointRain(writer);
+
+    if (trailSlots > 0) {
+        const size_t size = static_cast<size_t>(trailSlots) * rain.count * trailStride;
+        void *history = writer.add(checkpointTag("TRAL"), size);
+        const void *mapped;
+        GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, trailBuffer));
+        GL_CHECK(mapped = glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT));
+        memcpy(history, mapped, size);
+        GL_CHECK(glUnmapBuffer(GL_COPY_READ_BUFFER));
+    }
+}
+
+void MatrixApp::startCheckpoint(CheckpointWriter &writer) {
+    addCheckpointState(writer);
+    // The CPU rain is taken now, the GPU rain and the trail history are copied and added by finishCheckpoint
+    checkpointStateSize = gpuRain != nullptr ? gpuRain->stateSize() : 0;
+    const GLsizeiptr trailSize = static_cast<GLsizeiptr>(trailSlots) * rain.count * trailStride;
+    if (gpuRain == nullptr) {
+        addCheckpointRain(writer);
+    }
+    if (checkpointStateSize + trailSize == 0) {
+        return;
+    }
+    if (checkpointBuffer == 0) {
+        GL_CHECK(glGenBuffers(1, &checkpointBuffer));
+    }
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, checkpointBuffer));
+    GL_CHECK(glBufferData(GL_COPY_WRITE_BUFFER, checkpointStateSize + trailSize, nullptr, GL_STREAM_READ));
+    if (gpuRain != nullptr) {
+        gpuRain->copyState(checkpointBuffer, 0);
+    }
+    if (trailSize > 0) {
+        GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, trailBuffer));
+        GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, checkpointBuffer));
+        GL_CHECK(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, checkpointStateSize, trailSize));
+    }
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+void MatrixApp::finishCheckpoint(CheckpointWriter &writer) {
+    const GLsizeiptr trailSize = static_cast<GLsizeiptr>(trailSlots) * rain.count * trailStride;
+    if (checkpointStateSize + trailSize == 0) {
+        return;
+    }
+    const unsigned char *mapped;
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, checkpointBuffer));
+    GL_CHECK(mapped = static_cast<const unsigned char *>(
+        glMapBufferRange(GL_COPY_READ_BUFFER, 0, checkpointStateSize + trailSize, GL_MAP_READ_BIT)));
+    if (mapped != nullptr) {
+        if (gpuRain != nullptr) {
+            gpuRain->unpackState(reinterpret_cast<const GpuRainState *>(mapped), rain);
+            addCheckpointRain(writer);
         }
+        if (trailSize > 0) {
+            writer.add(checkpointTag("TRAL"), mapped + checkpointStateSize, static_cast<size_t>(trailSize));
+        }
+        GL_CHECK(glUnmapBuffer(GL_COPY_READ_BUFFER));
     }
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+}
 
-    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
-    GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER, 0, rainDrawData.size() * sizeof(RainDrawData), rainDrawData.data()));
+const matrixCheckpoint *MatrixApp::findCheckpoint(const int rainLimit) const {
+    if (rnd->checkpoint == nullptr) {
+        return nullptr;
+    }
+    const auto *saved = static_cast<const matrixCheckpoint *>(rnd->checkpoint->section(checkpointTag("MTRX"), sizeof(matrixCheckpoint)));
+    if (saved == nullptr) {
+        return nullptr;
+    }
+    if (saved->count != rainLimit || saved->width != rnd->opts->width || saved->height != rnd->opts->height ||
+        (rnd->opts->seed.has_value() && rnd->opts->seed.value() != saved->seed)) {
+        std::cerr << "Matrix checkpoint was saved with other drops, size or seed, starting fresh" << std::endl;
+        return nullptr;
+    }
+    // A truncated file or one saved with other raindrop arrays has no RAIN section of this size
+    if (rnd->checkpoint->section(checkpointTag("RAIN"), persistentRainArrays(rain).size() * rainLimit * 4) == nullptr) {
+        std::cerr << "Matrix checkpoint has no raindrops to restore, starting fresh" << std::endl;
+        return nullptr;
+    }
+    return saved;
+}
 
-    // Render
-    GL_CHECK(glBindVertexArray(vertexArray));
+void MatrixApp::restoreTrail(const matrixCheckpoint &saved) {
+    // Only a trail of the same length drawn from the same backend lines up
+    if (saved.trailSlots != trailSlots || saved.trailStride != trailStride) {
+        return;
+    }
+    const size_t size = static_cast<size_t>(trailSlots) * rain.count * trailStride;
+    const void *stamps = rnd->checkpoint->section(checkpointTag("TRST"), trailSlots * sizeof(float));
+    const void *history = rnd->checkpoint->section(checkpointTag("TRAL"), size);
+    if (stamps == nullptr || history == nullptr) {
+        return;
+    }
+    memcpy(trailStamps, stamps, trailSlots * sizeof(float));
+    trailHead = saved.trailHead;
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, trailBuffer));
+    GL_CHECK(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, static_cast<GLsizeiptr>(size), history));
+}
 
-    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, rainData.capacity()));
+void MatrixApp::fastForward(const float seconds) {
+    const float tick = tickLength > 0.0f ? tickLength : rnd->opts->swapTime;
+    const int ticks = static_cast<int>(seconds / tick);
+    if (ticks <= 0) {
+        return;
+    }
+    const float fall = tick * MATRIX_DELTA_MULTIPLIER;
+    const float height = static_cast<float>(rnd->opts->height);
+    // Only the stretches still showing in the trail or the ghosting at the end are kept
+    const float historySeconds = trailSlots > 0 ? static_cast<float>(trailSlots) * tick : ghostingHistoryFrames() / 60.0f;
+    const int historyStart = ticks - static_cast<int>(std::ceil(historySeconds / tick));
 
-    // rnd->fboPTextureOutput = atlas->glyphTexture;
+    std::vector<unsigned char> trail;
+    if (trailSlots > 0) {
+        trail.resize(static_cast<size_t>(trailSlots) * rain.count * trailStride);
+    }
+    warmUpSegments.clear();
+    for (int i = 0; i < rain.count; ++i) {
+        const size_t first = warmUpSegments.size();
+        float y = rain.y[i];
+        int begin = 0;
+        while (true) {
+            // Without the cursor a raindrop falls in a straight line, until the tick it leaves the screen and resets
+            const float step = (rain.speed[i] - rot_d15_d2) * fall;
+            int leave = ticks + 1;
+            if (fallUp && step < 0.0f) {
+                leave = std::max(1, static_cast<int>(std::ceil((height - y) / -step)));
+            } else if (!fallUp && step > 0.0f) {
+                leave = static_cast<int>(std::floor(y / step)) + 1;
+            }
+            const int end = std::min(begin + leave, ticks + 1);
+            if (end > historyStart) {
+                warmUpSegments.push_back({rain.x[i], y, step, rain.colorOffset[i], rain.spark[i], begin, end});
+            }
+            if (begin + leave > ticks) {
+                y -= static_cast<float>(ticks - begin) * step;
+                break;
+            }
+            begin += leave;
+            y = fallUp ? 0.0f : height;
+            resetRain(i, rainFrame + begin);
+        }
+        rain.y[i] = y;
+
+        // Slot 0 becomes the newest one, every slot behind it holds the raindrop a tick earlier
+        for (int age = 0; age < trailSlots; ++age) {
+            const int slot = (trailSlots - age) % trailSlots;
+            RainDrawData instance = {-height, -height, 0.0f, 0};
+            for (size_t s = first; s < warmUpSegments.size(); ++s) {
+                const matrixWarmUpSegment &segment = warmUpSegments[s];
+                if (ticks - age >= segment.begin && ticks - age < segment.end) {
+                    instance = {segment.x, segment.y - static_cast<float>(ticks - age - segment.begin) * segment.step,
+                                segment.colorOffset, segment.spark};
+                }
+            }
+            storeInstance(trail.data() + (static_cast<size_t>(slot) * rain.count + i) * trailStride, instance);
+        }
+    }
+
+    // Everything that follows the counters continues as if the ticks had run
+    rainFrame += ticks;
+    baseColor += static_cast<float>(ticks) * tick / MATRIX_DELTA_MULTIPLIER;
+    rnd->clock->elapsedTime += static_cast<double>(ticks) * tick;
+    warmUpTicks = ticks;
+    warmUpTick = tick;
+
+    if (trailSlots > 0) {
+        trailHead = 0;
+        for (int age = 0; age < trailSlots; ++age) {
+            trailStamps[(trailSlots - age) % trailSlots] = std::max(0.0f, rnd->clock->floatTime() - static_cast<float>(age) * tick);
+        }
+        GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, trailBuffer));
+        GL_CHECK(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, static_cast<GLsizeiptr>(trail.size()), trail.data()));
+        warmUpSegments.clear();
+    }
+}
+
+float MatrixApp::ghostingHistoryFrames() const {
+    // The ghosting pass fades color by the opacity and again by the faded alpha, so a glyph n frames old
+    // keeps opacity^(n(n+3)/2), solved here for the frames until that drops under MATRIX_WARMUP_MIN_WEIGHT
+    const float exponent = std::log(MATRIX_WARMUP_MIN_WEIGHT) / std::log(rnd->opts->ghostingPreviousFrameOpacity);
+    return (std::sqrt(9.0f + 8.0f * exponent) - 3.0f) / 2.0f;
+}
+
+void MatrixApp::warmUp() {
+    if (warmUpSegments.empty()) {
+        return;
+    }
+    // Glyph-sized steps along every kept stretch, oldest first so newer glyphs land on top like they would have
+    std::vector<unsigned char> samples;
+    std::vector<float> history;
+    const float opacity = rnd->opts->ghostingPreviousFrameOpacity;
+    for (const matrixWarmUpSegment &segment : warmUpSegments) {
+        const float stride = segment.step != 0.0f ? glyphSize / std::abs(segment.step) : 1.0f;
+        for (float t = static_cast<float>(segment.begin); t <= static_cast<float>(segment.end - 1); t += stride) {
+            const float age = static_cast<float>(warmUpTicks) - t;
+            const float frames = age * warmUpTick * 60.0f;
+            const float weight = std::pow(opacity, frames * (frames + 3.0f) / 2.0f);
+            if (age <= 0.0f || weight < MATRIX_WARMUP_MIN_WEIGHT) {
+                continue;
+            }
+            const float seconds = age * warmUpTick;
+            // The hue has moved on since, the color offset takes it back to what it was then
+            samples.resize(samples.size() + instanceStride);
+            storeInstance(samples.data() + samples.size() - instanceStride,
+                {segment.x, segment.y - (t - static_cast<float>(segment.begin)) * segment.step,
+                 segment.colorOffset - seconds / MATRIX_DELTA_MULTIPLIER, segment.spark});
+            history.push_back(seconds);
+            history.push_back(weight);
+        }
+    }
+    warmUpSegments.clear();
+    warmUpSegments.shrink_to_fit();
+    if (samples.empty()) {
+        return;
+    }
+
+    const GLsizeiptr instanceBytes = static_cast<GLsizeiptr>(samples.size());
+    const GLsizei sampleCount = static_cast<GLsizei>(history.size() / 2);
+    GLuint historyArray, historyBuffer;
+    GL_CHECK(glGenVertexArrays(1, &historyArray));
+    GL_CHECK(glBindVertexArray(historyArray));
+    GL_CHECK(glGenBuffers(1, &historyBuffer));
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, historyBuffer));
+    GL_CHECK(glBufferData(GL_ARRAY_BUFFER, instanceBytes + static_cast<GLsizeiptr>(history.size() * sizeof(float)), nullptr, GL_STATIC_DRAW));
+    GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER, 0, instanceBytes, samples.data()));
+    GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER, instanceBytes, static_cast<GLsizeiptr>(history.size() * sizeof(float)), history.data()));
+    bindInstanceAttributes(historyBuffer, instanceStride, 0);
+    GL_CHECK(glVertexAttribPointer(6, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void *>(instanceBytes)));
+    for (const GLuint attribute : {0u, 1u, 2u, 6u}) {
+        GL_CHECK(glEnableVertexAttribArray(attribute));
+        GL_CHECK(glVertexAttribDivisor(attribute, 1));
+    }
+
+    program->useProgram();
+    glyphCache->bind();
+    if (useWallPaperShader) {
+        GL_CHECK(glActiveTexture(GL_TEXTURE1));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, wallpaperTexture));
+    }
+    GL_CHECK(glUniform1f(ui_BaseColor, baseColor));
+    GL_CHECK(glUniform1f(ui_Time, rnd->clock->floatTime()));
+    GL_CHECK(glUniform1f(ui_TickAlpha, 1.0f));
+    GL_CHECK(glUniform1i(ui_History, 1));
+    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, sampleCount));
+    GL_CHECK(glUniform1i(ui_History, 0));
+
+    GL_CHECK(glBindVertexArray(vertexArray));
+    GL_CHECK(glDeleteVertexArrays(1, &historyArray));
+    GL_CHECK(glDeleteBuffers(1, &historyBuffer));
 }
 
 void MatrixApp::destroy() {
-    if (atlas != nullptr) {
-        atlas->destroy();
-        delete atlas;
+    if (glyphCache != nullptr) {
+        glyphCache->destroy();
+        delete glyphCache;
+        glyphCache = nullptr;
     }
-    GL_CHECK(glDeleteBuffers(1, &vertexBuffer));
+    instances.destroy();
     GL_CHECK(glDeleteVertexArrays(1, &vertexArray));
+    if (trailSlots > 0) {
+        GL_CHECK(glDeleteVertexArrays(1, &trailVertexArray));
+        GL_CHECK(glDeleteBuffers(1, &trailBuffer));
+    }
+    if (analyticRain) {
+        GL_CHECK(glDeleteBuffers(1, &motionBuffer));
+    }
+    if (particleVertexArray != 0) {
+        GL_CHECK(glDeleteVertexArrays(1, &particleVertexArray));
+    }
+    if (checkpointBuffer != 0) {
+        GL_CHECK(glDeleteBuffers(1, &checkpointBuffer));
+    }
+    rain.release();
+    if (gpuRain != nullptr) {
+        gpuRain->destroy();
+        delete gpuRain;
+        gpuRain = nullptr;
+    }
+    delete jobs;
+    jobs = nullptr;
     if (program != nullptr) {
         program->destroy();
         delete program;
     }
 }
 
-int MatrixApp::random_int(const int a, const int b) {
-    return a + rand() % ((b+1) - a);
+int MatrixApp::random_int(const uint32_t bits, const int a, const int b) {
+    return philoxRange(bits, a, b);
 }
 
-int MatrixApp::random_td_int(int a, int b)
+int MatrixApp::random_td_int(const uint32_t bits, int a, int b)
 {
     a /= MATRIX_TEXT_SIZE_DIVISOR;
     b /= MATRIX_TEXT_SIZE_DIVISOR;
-    return random_int(a, b) * MATRIX_TEXT_SIZE_DIVISOR;
+    return random_int(bits, a, b) * MATRIX_TEXT_SIZE_DIVISOR;
 }
 
-float MatrixApp::random_float(const float a, const float b) {
-    return a + static_cast<float>(rand()) / RAND_MAX * (b - a);
+float MatrixApp::random_float(const uint32_t bits, const float a, const float b) {
+    return a + philoxUnit(bits) * (b - a);
 }
 
-float MatrixApp::random_td_float(float a, float b) {
+float MatrixApp::random_td_float(const uint32_t bits, float a, float b) {
     a /= MATRIX_TEXT_SIZE_DIVISOR;
     b /= MATRIX_TEXT_SIZE_DIVISOR;
-    return random_float(a, b) * MATRIX_TEXT_SIZE_DIVISOR;
+    return random_float(bits, a, b) * MATRIX_TEXT_SIZE_DIVISOR;
+}
+
+int MatrixApp::randomMultiplier(const uint32_t bits) {
+    return random_int(bits, 0, 1) == 0 ? -1 : 1;
+}
+
+int MatrixApp::randomSpark(const uint32_t bits) {
+    return random_int(bits, 0, MATRIX_CHANCE_OF_SPARK);
+}
+
+int MatrixApp::randomSpeed(const uint32_t bits) {
+    return random_td_float(bits, 10, 20);
 }
 
-int MatrixApp::randomMultiplier() {
-    return random_int(0, 1) == 0 ? -1 : 1;
+float MatrixApp::randomColorOffset(const uint32_t bits) {
+    return random_float(bits, -MATRIX_COLOR_VARIATION, MATRIX_COLOR_VARIATION);
 }
 
-int MatrixApp::randomSpark() {
-    return random_int(0, MATRIX_CHANCE_OF_SPARK);
+void MatrixApp::resetRain(const int index, const uint32_t frame) {
+    const auto bits = random(index, frame, MATRIX_RANDOM_RESET);
+    rain.x[index] = random_td_float(bits[0], 0, rnd->opts->width);
+    rain.spark[index] = randomSpark(bits[1]);
+    rain.colorOffset[index] = randomColorOffset(bits[2]);
+    rain.speed[index] = randomSpeed(bits[3]);
+    if (fallUp) {
+        rain.speed[index] *= -1;
+    }
 }
 
-int MatrixApp::randomSpeed() const {
-    return random_td_float(10, 20);
+void MatrixApp::beginTick(const RainFrame &frame) {
+    // Every tick gets its own random counter, independent of the frame rate
+    rainFrame++;
+    particles.update(frame);
 }
 
-float MatrixApp::randomColorOffset() {
-    return random_float(-MATRIX_COLOR_VARIATION, MATRIX_COLOR_VARIATION);
+void MatrixApp::spawnParticles(const int amount, const float tick) {
+    const float x = static_cast<float>(rnd->events->mouseX);
+    const float y = static_cast<float>(rnd->opts->height - rnd->events->mouseY);
+    for (int i = 0; i < amount; ++i) {
+        // Spread along the path the cursor took since the last frame, so a fast stroke stays unbroken
+        const float along = static_cast<float>(i + 1) / static_cast<float>(amount);
+        const auto bits = random(particleSpawns, rainFrame, MATRIX_RANDOM_SPAWN);
+        RainParticle &particle = particles.spawn();
+        particle.x = lastCursorX + (x - lastCursorX) * along;
+        particle.y = lastCursorY + (y - lastCursorY) * along;
+        particle.pushX = 0.0f;
+        particle.pushY = 0.0f;
+        particle.speed = static_cast<float>(randomSpeed(bits[0]));
+        if (fallUp) {
+            particle.speed *= -1;
+        }
+        particle.colorOffset = randomColorOffset(bits[1]) + 0.5f;
+        particle.spark = randomSpark(bits[2]);
+        particle.life = rnd->events->mouseLeft ? 300 : 100;
+        particle.velocityX = 0.0f;
+        particle.velocityY = 0.0f;
+        // One in five flies off, the rest hold where they were drawn until their life runs out
+        if (random_int(bits[3], 0, 4) == 0) {
+            const float angle = random_float(random(particleSpawns, rainFrame, MATRIX_RANDOM_SPAWN_PUSH)[0], 0.0f, 2.0f * M_PI);
+            const float push = tick * MATRIX_DELTA_MULTIPLIER * MATRIX_SPEED_DRAW;
+            particle.pushX = std::cos(angle) * push;
+            particle.pushY = std::sin(angle) * push;
+        }
+        particleSpawns++;
+    }
+    lastCursorX = x;
+    lastCursorY = y;
+}
+
+void MatrixApp::streamParticles() {
+    // The rain never passes through instances on this path, so the segment carries only the particles
+    drawnParticles = particles.live();
+    if (drawnParticles == 0) {
+        return;
+    }
+    auto *segment = static_cast<unsigned char *>(instances.map());
+    const GLintptr velocityXOffset = instanceSlots * instanceStride;
+    const GLintptr velocityYOffset = velocityXOffset + instanceSlots * velocityStride;
+    particles.write({reinterpret_cast<RainDrawData *>(segment),
+                     reinterpret_cast<float *>(segment + velocityXOffset),
+                     reinterpret_cast<float *>(segment + velocityYOffset)}, 0);
+    const GLintptr offset = instances.unmap();
+    GL_CHECK(glBindVertexArray(particleVertexArray));
+    bindInstanceAttributes(instances.buffer(), instanceStride, offset);
+    bindVelocityAttributes(instances.buffer(), velocityStride, offset + velocityXOffset, offset + velocityYOffset);
+    GL_CHECK(glBindVertexArray(vertexArray));
 }
 
-void MatrixApp::resetRain(const int index) {
-    rainDrawData[index].x = random_td_float(0, rnd->opts->width);
-    rainDrawData[index].spark = randomSpark();
-    rainDrawData[index].colorOffset = randomColorOffset();
-    rainData[index].speed = randomSpeed();
-    if constexpr (MATRIX_UP) {
-        rainData[index].speed *= -1;
+void MatrixApp::rollRain(const int begin, const int end) {
+    // Each raindrop only depends on its own counter, so any range can be rolled independently
+    for (int i = begin; i < end; ++i) {
+        const auto bits = random(i, rainFrame, MATRIX_RANDOM_ROLL);
+        rain.jitter[i] = rot_d15_m2 * randomMultiplier(bits[0]);
+        rain.rolls[i] = (random_int(bits[1], 0, 10) == 0 ? RAIN_CURSOR_MISS : 0) |
+                        (random_int(bits[2], 0, 1000) == 0 ? RAIN_COLUMN_JUMP : 0);
     }
 }
 
-void MatrixApp::incrementRain(const int index, const bool reassigned) {
-    // Move the raindrop along its path
-    const float addX = rot_d15_m2 * randomMultiplier();
-    const float speed = rainData[index].speed - rot_d15_d2;
+void MatrixApp::updateRain(const RainFrame &frame, const RainOutput &out) {
+    // The grid is only kept up to date while a cursor can push the rain
+    const bool collectMoves = frame.cursorCount > 0;
+    if (jobs == nullptr) {
+        rollRain(0, activeDrops);
+        if (collectMoves) {
+            chunkMovedDrops[0].clear();
+            grid.collect(rain, 0, activeDrops, chunkMovedDrops[0]);
+        }
+        pushRainFromCursors(frame, 1);
+        activeCursorPardons = rainKernel(rain, frame, 0, activeDrops, out);
+        return;
+    }
 
-    float mouseX = static_cast<float>(rnd->events->mouseX);
-    float mouseY = static_cast<float>(rnd->opts->height - rnd->events->mouseY);
-    float dx = rainDrawData[index].x - mouseX;
-    float dy = rainDrawData[index].y - mouseY;
-    float distance = sqrt(dx * dx + dy * dy);
+    // Chunks only touch their own raindrops, and the counts are merged in chunk order
+    const int chunks = (activeDrops + MATRIX_RAIN_CHUNK - 1) / MATRIX_RAIN_CHUNK;
+    jobs->parallelFor(chunks, [&](const int chunk) {
+        const int begin = chunk * MATRIX_RAIN_CHUNK;
+        const int end = std::min(begin + MATRIX_RAIN_CHUNK, activeDrops);
+        rollRain(begin, end);
+        if (collectMoves) {
+            chunkMovedDrops[chunk].clear();
+            grid.collect(rain, begin, end, chunkMovedDrops[chunk]);
+        }
+    });
+    pushRainFromCursors(frame, chunks);
+    jobs->parallelFor(chunks, [&](const int chunk) {
+        const int begin = chunk * MATRIX_RAIN_CHUNK;
+        const int end = std::min(begin + MATRIX_RAIN_CHUNK, activeDrops);
+        chunkCursorPardons[chunk] = rainKernel(rain, frame, begin, end, out);
+    });
+    activeCursorPardons = 0;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        activeCursorPardons += chunkCursorPardons[chunk];
+    }
+}
 
-    if (reassigned) {
-        rainData[index].cursorPardons = rnd->events->mouseLeft ? 300 : 100;
-        rainDrawData[index].colorOffset += 0.5;
-        rainDrawData[index].x = mouseX;
-        rainDrawData[index].y = mouseY;
-        if (random_int(0, 4) == 0) {
-            rainData[index].pushX = cos(random_int(0, 360) * M_PI / 180.0f) * rnd->clock->deltaTime * MATRIX_DELTA_MULTIPLIER * MATRIX_SPEED_DRAW;
-            rainData[index].pushY = sin(random_int(0, 360) * M_PI / 180.0f) * rnd->clock->deltaTime *  MATRIX_DELTA_MULTIPLIER * MATRIX_SPEED_DRAW;
+void MatrixApp::setupMotion() {
+    motionTick = tickLength > 0.0f ? tickLength : rnd->opts->swapTime;
+    motionEpoch = rnd->clock->elapsedTime;
+    motion.resize(rain.count);
+    motionEventTime.resize(rain.count);
+    motionEvent.resize(rain.count);
+    for (int i = 0; i < rain.count; ++i) {
+        startMotion(i, motionEpoch);
+    }
+    // Everything goes up at once here
+    dirtyMotion.clear();
+    motionX.resize(rain.count);
+    motionY.resize(rain.count);
+    // A checkpoint can come back with raindrops still pushed aside
+    for (int i = 0; i < rain.count; ++i) {
+        if (rain.pardons[i] == 0 && (rain.pushX[i] != 0.0f || rain.pushY[i] != 0.0f)) {
+            displacedDrops.push_back(i);
+        }
+    }
+
+    GL_CHECK(glGenBuffers(1, &motionBuffer));
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, motionBuffer));
+    GL_CHECK(glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(rain.count * sizeof(RainMotionData)), motion.data(), GL_DYNAMIC_DRAW));
+    GL_CHECK(glBindVertexArray(vertexArray));
+    bindMotionAttributes(motionBuffer);
+    GL_CHECK(glEnableVertexAttribArray(7));
+    GL_CHECK(glVertexAttribDivisor(7, 1));
+    program->useProgram();
+    GL_CHECK(glUniform1i(ui_Motion, 1));
+}
+
+void MatrixApp::startMotion(const int index, const double time) {
+    RainMotionData &record = motion[index];
+    record = {rain.x[index], rain.y[index], rain.colorOffset[index], rain.spark[index], 0.0f, 0.0f,
+              static_cast<float>(time - motionEpoch), 0.0f};
+    double duration;
+    if (rain.pardons[index] > 0) {
+        // A burst expands by its push every tick until the pardons run out, then falls from wherever it got to
+        record.velocityX = rain.pushX[index] / motionTick;
+        record.velocityY = rain.pushY[index] / motionTick;
+        duration = rain.pardons[index] * motionTick;
+        motionEvent[index] = MATRIX_MOTION_BURST_END;
+    } else {
+        // The jitter is left out, it only wobbles the column a few pixels either way
+        const float fall = (rain.speed[index] - rot_d15_d2) * MATRIX_DELTA_MULTIPLIER;
+        record.velocityY = -fall;
+        duration = fall > 0.0f ? rain.y[index] / fall :
+                   fall < 0.0f ? (static_cast<float>(rnd->opts->height) - rain.y[index]) / -fall : INFINITY;
+        // The 1 in 1001 roll every tick becomes a geometric wait until the next column jump
+        const float roll = philoxUnit(random(index, motionTickAt(time), MATRIX_RANDOM_JUMP)[0]);
+        const double jump = (std::floor(std::log1p(-roll) / std::log1p(-1.0 / 1001.0)) + 1.0) * motionTick;
+        motionEvent[index] = jump < duration ? MATRIX_MOTION_JUMP : MATRIX_MOTION_RESET;
+        duration = std::min(duration, jump);
+    }
+    motionEventTime[index] = time + duration;
+    motionEvents.emplace(motionEventTime[index], index);
+    dirtyMotion.push_back(index);
+}
+
+void MatrixApp::advanceMotion(const double now) {
+    while (!motionEvents.empty() && motionEvents.top().first <= now) {
+        const auto [time, index] = motionEvents.top();
+        motionEvents.pop();
+        // A later stretch replaced the one this event belonged to
+        if (time != motionEventTime[index]) {
+            continue;
+        }
+        const RainMotionData &record = motion[index];
+        const float elapsed = static_cast<float>(time - motionEpoch) - record.startTime;
+        const float x = record.x + record.velocityX * elapsed;
+        const float y = record.y + record.velocityY * elapsed;
+        if (motionEvent[index] == MATRIX_MOTION_BURST_END) {
+            rain.x[index] = x;
+            rain.y[index] = y;
+            rain.pardons[index] = 0;
+            rain.pushX[index] = 0.0f;
+            rain.pushY[index] = 0.0f;
+            activeCursorPardons--;
+        } else if (motionEvent[index] == MATRIX_MOTION_JUMP) {
+            const uint32_t bits = random(index, motionTickAt(time), MATRIX_RANDOM_ROLL)[3];
+            rain.x[index] = random_td_float(bits, 0, rnd->opts->width);
+            rain.y[index] = y;
         } else {
-            rainData[index].pushX = 0;
-            rainData[index].pushY = 0;
+            rain.y[index] = fallUp ? 0.0f : static_cast<float>(rnd->opts->height);
+            resetRain(index, motionTickAt(time));
+        }
+        startMotion(index, time);
+    }
+}
+
+void MatrixApp::pushMotion(const RainFrame &frame, const double now) {
+    // The grid and the cursor pass see the raindrops where their stretches have them now
+    RainStore current = rain;
+    current.x = motionX.data();
+    current.y = motionY.data();
+    const float sinceEpoch = static_cast<float>(now - motionEpoch);
+    const auto place = [&](const int begin, const int end, std::vector<int> &moved) {
+        rollRain(begin, end);
+        for (int i = begin; i < end; ++i) {
+            const float elapsed = sinceEpoch - motion[i].startTime;
+            motionX[i] = motion[i].x + motion[i].velocityX * elapsed;
+            motionY[i] = motion[i].y + motion[i].velocityY * elapsed;
         }
+        moved.clear();
+        grid.collect(current, begin, end, moved);
+    };
+    int chunks = 1;
+    if (jobs == nullptr) {
+        place(0, activeDrops, chunkMovedDrops[0]);
+    } else {
+        chunks = (activeDrops + MATRIX_RAIN_CHUNK - 1) / MATRIX_RAIN_CHUNK;
+        jobs->parallelFor(chunks, [&](const int chunk) {
+            const int begin = chunk * MATRIX_RAIN_CHUNK;
+            place(begin, std::min(begin + MATRIX_RAIN_CHUNK, activeDrops), chunkMovedDrops[chunk]);
+        });
+    }
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        grid.relink(current, chunkMovedDrops[chunk]);
     }
+    pushedDrops.clear();
+    pushRain(current, grid, frame, activeDrops, &pushedDrops);
 
-#ifndef __ANDROID__
-    if (rainData[index].cursorPardons == 0 and distance < mouseRadius and random_int(0, 10) != 0) {
-        // Push the raindrop away from the cursor
-        const float force = (mouseRadius - distance) / mouseRadius;
-        const float pushX = dx / distance * force * 100.0f; // Adjust the push strength as needed
-        const float pushY = dy / distance * force * 100.0f;
+    // Like the kernel, a raindrop the cursor let go of moves back by everything it was pushed. Asleep ones wait
+    // until they are active again and a burst takes the push over for its own expansion
+    for (const int i : displacedDrops) {
+        if (i >= activeDrops) {
+            pushedDrops.push_back(i);
+            continue;
+        }
+        if ((rain.rolls[i] & RAIN_PUSHED) != 0 || rain.pardons[i] > 0) {
+            continue;
+        }
+        rain.x[i] = motionX[i] - rain.pushX[i];
+        rain.y[i] = motionY[i] - rain.pushY[i];
+        rain.pushX[i] = 0.0f;
+        rain.pushY[i] = 0.0f;
+        startMotion(i, now);
+    }
+    for (const int i : pushedDrops) {
+        if (i >= activeDrops) {
+            continue;
+        }
+        rain.x[i] = motionX[i] + rain.forceX[i];
+        rain.y[i] = motionY[i] + rain.forceY[i];
+        rain.pushX[i] += rain.forceX[i];
+        rain.pushY[i] += rain.forceY[i];
+        startMotion(i, now);
+    }
+    displacedDrops.swap(pushedDrops);
+}
 
-        rainDrawData[index].x += pushX;
-        rainData[index].pushX += pushX;
-        rainData[index].pushY += pushY;
-        rainDrawData[index].y += pushY;
-    } else
-#endif
-    if (rainData[index].cursorPardons > 0) {
-        // Expand from the cursor
-        rainDrawData[index].x += rainData[index].pushX;
-        rainDrawData[index].y += rainData[index].pushY;
+void MatrixApp::rebaseMotion(const double now) {
+    // Every stretch restarts where it is now, the motion carries on but the start times shrink back to zero
+    const float sinceEpoch = static_cast<float>(now - motionEpoch);
+    for (int i = 0; i < rain.count; ++i) {
+        const float elapsed = sinceEpoch - motion[i].startTime;
+        rain.x[i] = motion[i].x + motion[i].velocityX * elapsed;
+        rain.y[i] = motion[i].y + motion[i].velocityY * elapsed;
+        if (rain.pardons[i] > 0) {
+            rain.pardons[i] = std::max(1, static_cast<int>(std::ceil((motionEventTime[i] - now) / motionTick)));
+        }
+    }
+    motionEpoch = now;
+    motionEvents = {};
+    for (int i = 0; i < rain.count; ++i) {
+        startMotion(i, now);
+    }
+}
 
-        rainData[index].cursorPardons--;
-        if (rainData[index].cursorPardons == 0) {
-            rainData[index].pushX = 0;
-            rainData[index].pushY = 0;
+void MatrixApp::uploadMotion() {
+    if (dirtyMotion.empty()) {
+        return;
+    }
+    // Nearby records go up together, a few clean ones in between cost less than another call
+    std::sort(dirtyMotion.begin(), dirtyMotion.end());
+    dirtyMotion.erase(std::unique(dirtyMotion.begin(), dirtyMotion.end()), dirtyMotion.end());
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, motionBuffer));
+    size_t first = 0;
+    for (size_t i = 1; i <= dirtyMotion.size(); ++i) {
+        if (i == dirtyMotion.size() || dirtyMotion[i] - dirtyMotion[i - 1] > MATRIX_MOTION_RANGE_GAP) {
+            const int begin = dirtyMotion[first];
+            const int end = dirtyMotion[i - 1] + 1;
+            GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(begin * sizeof(RainMotionData)),
+                static_cast<GLsizeiptr>((end - begin) * sizeof(RainMotionData)), motion.data() + begin));
+            first = i;
         }
-    } else if (rainData[index].pushX != 0 || rainData[index].pushY != 0) {
-        // Reset the push force
-        rainDrawData[index].x -= rainData[index].pushX;
-        rainDrawData[index].y -= rainData[index].pushY;
-        rainData[index].pushX = 0;
-        rainData[index].pushY = 0;
     }
+    dirtyMotion.clear();
+}
+
+void MatrixApp::bindMotionAttributes(const GLuint buffer) const {
+    // Expects the vertex array to be bound, the velocities are per second here instead of per tick
+    bindInstanceAttributes(buffer, sizeof(RainMotionData), 0);
+    bindVelocityAttributes(buffer, sizeof(RainMotionData), offsetof(RainMotionData, velocityX), offsetof(RainMotionData, velocityY));
+    GL_CHECK(glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(RainMotionData), reinterpret_cast<void *>(offsetof(RainMotionData, startTime))));
+}
 
-    if (rainData[index].cursorPardons == 0) {
-        rainDrawData[index].x += addX;
-        rainDrawData[index].y -= speed * rnd->clock->deltaTime * MATRIX_DELTA_MULTIPLIER;
+uint32_t MatrixApp::motionTickAt(const double time) const {
+    // Events draw their random numbers from the tick they fall in, like the ticked simulation would
+    return static_cast<uint32_t>(time / motionTick);
+}
+
+void MatrixApp::packInstances(const RainOutput &out, unsigned char *segment, const GLintptr velocityXOffset, const GLintptr velocityYOffset) {
+    auto *packed = reinterpret_cast<RainCompactData *>(segment);
+    auto *velocityX = reinterpret_cast<int16_t *>(segment + velocityXOffset);
+    auto *velocityY = reinterpret_cast<int16_t *>(segment + velocityYOffset);
+    // The particles written after the raindrops are packed with them
+    const int count = activeDrops + drawnParticles;
+    if (jobs == nullptr) {
+        packRainOutput(out, 0, count, packed, velocityX, velocityY);
+        return;
     }
+    const int chunks = (count + MATRIX_RAIN_CHUNK - 1) / MATRIX_RAIN_CHUNK;
+    jobs->parallelFor(chunks, [&](const int chunk) {
+        const int begin = chunk * MATRIX_RAIN_CHUNK;
+        packRainOutput(out, begin, std::min(begin + MATRIX_RAIN_CHUNK, count), packed, velocityX, velocityY);
+    });
+}
 
-    if (random_int(0, 1000) == 0) {
-        rainDrawData[index].x = random_td_float(0, rnd->opts->width);
+void MatrixApp::pushRainFromCursors(const RainFrame &frame, const int chunks) {
+    // Only the cells around the cursors are visited, the raindrops the chunks found in new cells are relinked first
+    if (frame.cursorCount > 0) {
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            grid.relink(rain, chunkMovedDrops[chunk]);
+        }
+        pushRain(rain, grid, frame, activeDrops);
     }
+}
+
+void MatrixApp::fixupRain(void *context, const int index, const int events) {
+    auto *app = static_cast<MatrixApp *>(context);
+    RainStore &rain = app->rain;
 
+    if (events & RAIN_COLUMN_JUMP) {
+        // The fourth lane of this frame's roll is the new column
+        const uint32_t bits = app->random(index, app->rainFrame, MATRIX_RANDOM_ROLL)[3];
+        rain.x[index] = random_td_float(bits, 0, app->rnd->opts->width);
+    }
 
     // Finally check the position of the raindrop to see if it needs to be reset
-    if (MATRIX_UP && rainDrawData[index].y >= rnd->opts->height) {
-        rainDrawData[index].y = 0;
-        resetRain(index);
-    } else if (rainDrawData[index].y < 0) {
-        rainDrawData[index].y = static_cast<float>(rnd->opts->height);
-        resetRain(index);
+    if (app->fallUp && rain.y[index] >= app->rnd->opts->height) {
+        rain.y[index] = 0;
+        app->resetRain(index, app->rainFrame);
+    } else if (rain.y[index] < 0) {
+        rain.y[index] = static_cast<float>(app->rnd->opts->height);
+        app->resetRain(index, app->rainFrame);
     }
 }
+
+void MatrixApp::bindInstanceAttributes(const GLuint buffer, const GLsizei stride, const GLintptr offset) const {
+    // Expects the vertex array to be bound, position, color offset and spark sit at the start of every instance
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+    if (compactInstances) {
+        // The shader scales the positions back by u_PositionScale, the color offset comes back as its fraction
+        GL_CHECK(glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, stride, reinterpret_cast<void *>(offset)));
+        GL_CHECK(glVertexAttribPointer(1, 1, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast<void *>(offset + offsetof(RainCompactData, colorOffset))));
+        GL_CHECK(glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, stride, reinterpret_cast<void *>(offset + offsetof(RainCompactData, spark))));
+        // Only packed instances have the fraction, float ones leave the attribute disabled and read 0
+        GL_CHECK(glVertexAttribPointer(8, 2, GL_UNSIGNED_BYTE, GL_FALSE, stride, reinterpret_cast<void *>(offset + offsetof(RainCompactData, fractionX))));
+        GL_CHECK(glEnableVertexAttribArray(8));
+        GL_CHECK(glVertexAttribDivisor(8, 1));
+        return;
+    }
+    GL_CHECK(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset)));
+    GL_CHECK(glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset + 2 * sizeof(float))));
+    GL_CHECK(glVertexAttribIPointer(2, 1, GL_INT, stride, reinterpret_cast<void *>(offset + 3 * sizeof(float))));
+}
+
+void MatrixApp::bindVelocityAttributes(const GLuint buffer, const GLsizei stride, const GLintptr xOffset, const GLintptr yOffset) const {
+    const GLenum type = compactInstances ? GL_SHORT : GL_FLOAT;
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+    GL_CHECK(glVertexAttribPointer(4, 1, type, GL_FALSE, stride, reinterpret_cast<void *>(xOffset)));
+    GL_CHECK(glVertexAttribPointer(5, 1, type, GL_FALSE, stride, reinterpret_cast<void *>(yOffset)));
+}
+
+void MatrixApp::storeInstance(unsigned char *destination, const RainDrawData &instance) const {
+    if (compactInstances) {
+        const RainCompactData packed = packRainInstance(instance);
+        memcpy(destination, &packed, sizeof(packed));
+    } else {
+        memcpy(destination, &instance, sizeof(instance));
+    }
+}
+
+void MatrixApp::recordTrail(const GLuint source, const GLintptr offset) {
+    // One slot per rendered frame that ticked, copied on the GPU so the instances never come back to the CPU
+    trailHead = (trailHead + 1) % trailSlots;
+    trailStamps[trailHead] = rnd->clock->floatTime();
+    // Slots keep their full size so the layout holds when the governor changes the active raindrops
+    const GLsizeiptr size = static_cast<GLsizeiptr>(rain.count) * trailStride;
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, source));
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, trailBuffer));
+    GL_CHECK(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, trailHead * size,
+        static_cast<GLsizeiptr>(activeDrops) * trailStride));
+}
+
+void MatrixApp::drawTrail() {
+    // Expects the program to be in use, the shader fades each slot by its age behind trailHead
+    GL_CHECK(glUniform1i(ui_TrailSlots, trailSlots));
+    GL_CHECK(glUniform1i(ui_TrailHead, trailHead));
+    GL_CHECK(glUniform1i(ui_TrailActive, activeDrops));
+    GL_CHECK(glUniform1fv(ui_TrailStamps, trailSlots, trailStamps));
+    GL_CHECK(glBindVertexArray(trailVertexArray));
+    GL_CHECK(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, rain.count * trailSlots));
+    GL_CHECK(glBindVertexArray(vertexArray));
+    GL_CHECK(glUniform1i(ui_TrailSlots, 0));
+}
@@ -0,0 +1,125 @@
+#include "apps/matrix_gpu_rain.h"
+#include "apps/matrix.h"
+#include <gl_errors.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "matrix_rain_update_shader.h"
+#include "discard_fragment_shader.h"
+
+void GpuRain::setup(const RainStore &rain, const uint64_t seed, const float width, const float height, const float jitter, const bool fallUp) {
+    count = rain.count;
+
+    program = new ShaderProgram();
+    program->loadShader(matrixRainUpdateShader, sizeof(matrixRainUpdateShader), GL_VERTEX_SHADER);
+    program->loadShader(discardFragmentShader, sizeof(discardFragmentShader), GL_FRAGMENT_SHADER);
+    constexpr const GLchar *varyings[] = {"tf_Position", "tf_ColorOffset", "tf_Spark", "tf_Speed", "tf_Push", "tf_Pardons", "tf_Velocity"};
+    program->transformFeedbackVaryings(varyings, sizeof(varyings) / sizeof(varyings[0]));
+    program->linkProgram();
+    program->useProgram();
+
+    GL_CHECK(glUniform2ui(program->getUniformLocation("u_Seed"), static_cast<GLuint>(seed), static_cast<GLuint>(seed >> 32)));
+    GL_CHECK(glUniform2f(program->getUniformLocation("u_ScreenSize"), width, height));
+    GL_CHECK(glUniform1f(program->getUniformLocation("u_Jitter"), jitter));
+    GL_CHECK(glUniform1i(program->getUniformLocation("u_FallUp"), fallUp));
+    GL_CHECK(glUniform1i(program->getUniformLocation("u_ChanceOfSpark"), MATRIX_CHANCE_OF_SPARK));
+    GL_CHECK(glUniform1f(program->getUniformLocation("u_ColorVariation"), MATRIX_COLOR_VARIATION));
+
+    ui_Frame = program->getUniformLocation("u_Frame");
+    ui_Cursors = program->getUniformLocation("u_Cursors");
+    ui_CursorCount = program->getUniformLocation("u_CursorCount");
+    ui_CursorRadius = program->getUniformLocation("u_CursorRadius");
+    ui_SpeedBias = program->getUniformLocation("u_SpeedBias");
+    ui_Fall = program->getUniformLocation("u_Fall");
+
+    // The initial placement is done once on the CPU
+    std::vector<GpuRainState> state(count);
+    for (int i = 0; i < count; ++i) {
+        state[i] = {rain.x[i], rain.y[i], rain.colorOffset[i], rain.spark[i], rain.speed[i], rain.pushX[i], rain.pushY[i], rain.pardons[i], 0.0f, 0.0f};
+    }
+
+    GL_CHECK(glGenBuffers(2, buffers));
+    GL_CHECK(glGenVertexArrays(2, vertexArrays));
+    for (int i = 0; i < 2; ++i) {
+        GL_CHECK(glBindVertexArray(vertexArrays[i]));
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, buffers[i]));
+        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, count * sizeof(GpuRainState), state.data(), GL_DYNAMIC_COPY));
+
+        constexpr GLsizei stride = sizeof(GpuRainState);
+        GL_CHECK(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(GpuRainState, x))));
+        GL_CHECK(glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(GpuRainState, colorOffset))));
+        GL_CHECK(glVertexAttribIPointer(2, 1, GL_INT, stride, reinterpret_cast<void *>(offsetof(GpuRainState, spark))));
+        GL_CHECK(glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(GpuRainState, speed))));
+        GL_CHECK(glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(GpuRainState, pushX))));
+        GL_CHECK(glVertexAttribIPointer(5, 1, GL_INT, stride, reinterpret_cast<void *>(offsetof(GpuRainState, pardons))));
+        for (GLuint attribute = 0; attribute < 6; ++attribute) {
+            GL_CHECK(glEnableVertexAttribArray(attribute));
+        }
+    }
+    GL_CHECK(glBindVertexArray(0));
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    current = 0;
+}
+
+void GpuRain::update(const RainFrame &frame, const uint32_t rainFrame, const int active) {
+    const int next = 1 - current;
+
+    program->useProgram();
+    GL_CHECK(glUniform1ui(ui_Frame, rainFrame));
+    GL_CHECK(glUniform2fv(ui_Cursors, frame.cursorCount, &frame.cursors[0].x));
+    GL_CHECK(glUniform1i(ui_CursorCount, frame.cursorCount));
+    GL_CHECK(glUniform1f(ui_CursorRadius, frame.cursorRadius));
+    GL_CHECK(glUniform1f(ui_SpeedBias, frame.speedBias));
+    GL_CHECK(glUniform1f(ui_Fall, frame.fall));
+
+    // Read the current state, capture the next one, nothing reaches the rasterizer
+    GL_CHECK(glBindVertexArray(vertexArrays[current]));
+    GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[next]));
+    GL_CHECK(glEnable(GL_RASTERIZER_DISCARD));
+    GL_CHECK(glBeginTransformFeedback(GL_POINTS));
+    GL_CHECK(glDrawArrays(GL_POINTS, 0, std::min(active, count)));
+    GL_CHECK(glEndTransformFeedback());
+    GL_CHECK(glDisable(GL_RASTERIZER_DISCARD));
+    GL_CHECK(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+    GL_CHECK(glBindVertexArray(0));
+
+    current = next;
+}
+
+void GpuRain::readBack(RainStore &rain) const {
+    const GpuRainState *state;
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, buffers[current]));
+    GL_CHECK(state = static_cast<const GpuRainState *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, stateSize(), GL_MAP_READ_BIT)));
+    unpackState(state, rain);
+    GL_CHECK(glUnmapBuffer(GL_COPY_READ_BUFFER));
+}
+
+void GpuRain::copyState(const GLuint target, const GLintptr offset) const {
+    GL_CHECK(glBindBuffer(GL_COPY_READ_BUFFER, buffers[current]));
+    GL_CHECK(glBindBuffer(GL_COPY_WRITE_BUFFER, target));
+    GL_CHECK(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, stateSize()));
+}
+
+void GpuRain::unpackState(const GpuRainState *state, RainStore &rain) const {
+    for (int i = 0; i < count; ++i) {
+        rain.x[i] = state[i].x;
+        rain.y[i] = state[i].y;
+        rain.colorOffset[i] = state[i].colorOffset;
+        rain.spark[i] = state[i].spark;
+        rain.speed[i] = state[i].speed;
+        rain.pushX[i] = state[i].pushX;
+        rain.pushY[i] = state[i].pushY;
+        rain.pardons[i] = state[i].pardons;
+    }
+}
+
+void GpuRain::destroy() {
+    GL_CHECK(glDeleteBuffers(2, buffers));
+    GL_CHECK(glDeleteVertexArrays(2, vertexArrays));
+    if (program != nullptr) {
+        program->destroy();
+        delete program;
+        program = nullptr;
+    }
+}
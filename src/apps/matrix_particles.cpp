@@ -0,0 +1,49 @@
+#include "apps/matrix_particles.h"
+
+void ParticlePool::allocate(const int capacity) {
+    particles.assign(capacity, RainParticle{});
+    count = 0;
+    recycle = 0;
+}
+
+RainParticle &ParticlePool::spawn() {
+    if (count < capacity()) {
+        return particles[count++];
+    }
+    // Holding the button down keeps drawing, the slots handed out longest ago are likely the oldest
+    RainParticle &particle = particles[recycle];
+    recycle = (recycle + 1) % capacity();
+    return particle;
+}
+
+void ParticlePool::update(const RainFrame &frame) {
+    for (int i = 0; i < count;) {
+        RainParticle &particle = particles[i];
+        const float startX = particle.x, startY = particle.y;
+        if (particle.life > 0) {
+            particle.x += particle.pushX;
+            particle.y += particle.pushY;
+            particle.life--;
+        } else {
+            particle.y -= (particle.speed - frame.speedBias) * frame.fall;
+        }
+        particle.velocityX = particle.x - startX;
+        particle.velocityY = particle.y - startY;
+
+        // Unlike a raindrop a particle is gone once it leaves the screen
+        if (particle.y < 0.0f || (frame.fallUp && particle.y >= frame.height)) {
+            particle = particles[--count];
+            continue;
+        }
+        ++i;
+    }
+}
+
+void ParticlePool::write(const RainOutput &out, const int begin) const {
+    for (int i = 0; i < count; ++i) {
+        const RainParticle &particle = particles[i];
+        out.instances[begin + i] = {particle.x, particle.y, particle.colorOffset, particle.spark};
+        out.velocityX[begin + i] = particle.velocityX;
+        out.velocityY[begin + i] = particle.velocityY;
+    }
+}
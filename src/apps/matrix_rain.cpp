@@ -0,0 +1,119 @@
+#include "apps/matrix_rain_kernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+#if defined(MATRIX_RAIN_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static int paddedCount(const int count) {
+    return (count + MATRIX_RAIN_LANES - 1) / MATRIX_RAIN_LANES * MATRIX_RAIN_LANES;
+}
+
+void RainStore::allocate(const int count) {
+    release();
+    this->count = count;
+
+    // One block for every array, each array starts on its own aligned boundary
+    const size_t stride = paddedCount(count) * sizeof(float);
+    constexpr int arrays = 12;
+    block = ::operator new(stride * arrays, std::align_val_t(MATRIX_RAIN_ALIGNMENT));
+    memset(block, 0, stride * arrays);
+
+    auto *base = static_cast<unsigned char *>(block);
+    x = reinterpret_cast<float *>(base);
+    y = reinterpret_cast<float *>(base + stride);
+    speed = reinterpret_cast<float *>(base + stride * 2);
+    pushX = reinterpret_cast<float *>(base + stride * 3);
+    pushY = reinterpret_cast<float *>(base + stride * 4);
+    colorOffset = reinterpret_cast<float *>(base + stride * 5);
+    pardons = reinterpret_cast<int *>(base + stride * 6);
+    spark = reinterpret_cast<int *>(base + stride * 7);
+    jitter = reinterpret_cast<float *>(base + stride * 8);
+    rolls = reinterpret_cast<int *>(base + stride * 9);
+    forceX = reinterpret_cast<float *>(base + stride * 10);
+    forceY = reinterpret_cast<float *>(base + stride * 11);
+}
+
+void RainStore::release() {
+    if (block != nullptr) {
+        ::operator delete(block, std::align_val_t(MATRIX_RAIN_ALIGNMENT));
+        block = nullptr;
+    }
+    count = 0;
+}
+
+static int16_t packVelocity(const float value) {
+    // Larger jumps clamp, they only bend the frames between two ticks
+    return static_cast<int16_t>(std::clamp(std::lround(value * MATRIX_RAIN_VELOCITY_SCALE), -32768L, 32767L));
+}
+
+RainCompactData packRainInstance(const RainDrawData &instance) {
+    // Off-screen raindrops clamp, they are not drawn anywhere visible either way
+    constexpr long fraction = MATRIX_RAIN_FIXED_FRACTION;
+    const long x = std::clamp(std::lround(instance.x * MATRIX_RAIN_FIXED_SCALE * fraction), -32768L * fraction, 32768L * fraction - 1);
+    const long y = std::clamp(std::lround(instance.y * MATRIX_RAIN_FIXED_SCALE * fraction), -32768L * fraction, 32768L * fraction - 1);
+    RainCompactData packed{};
+    // The fraction is always added on top, so the whole steps round down, negative ones included
+    packed.fractionX = static_cast<uint8_t>(x & (fraction - 1));
+    packed.fractionY = static_cast<uint8_t>(y & (fraction - 1));
+    packed.x = static_cast<int16_t>((x - packed.fractionX) / fraction);
+    packed.y = static_cast<int16_t>((y - packed.fractionY) / fraction);
+    packed.colorOffset = static_cast<uint8_t>(std::lround((instance.colorOffset - std::floor(instance.colorOffset)) * 255.0f));
+    packed.spark = static_cast<uint8_t>(instance.spark);
+    return packed;
+}
+
+void packRainOutput(const RainOutput &in, const int begin, const int end, RainCompactData *instances, int16_t *velocityX, int16_t *velocityY) {
+    for (int i = begin; i < end; ++i) {
+        instances[i] = packRainInstance(in.instances[i]);
+        velocityX[i] = packVelocity(in.velocityX[i]);
+        velocityY[i] = packVelocity(in.velocityY[i]);
+    }
+}
+
+RainKernel rainKernelScalar(const unsigned features) {
+    return rainKernelWith<ScalarLanes>(features);
+}
+
+#ifdef MATRIX_RAIN_X86
+#ifdef _MSC_VER
+static bool cpuSupports(const int leaf7Bit, const unsigned long long xcr0Mask) {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // OSXSAVE, otherwise the OS does not save the wide registers
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & xcr0Mask) != xcr0Mask) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << leaf7Bit)) != 0;
+}
+
+static bool cpuSupportsAvx2() { return cpuSupports(5, 0x6); }
+static bool cpuSupportsAvx512() { return cpuSupports(16, 0xE6); }
+#else
+static bool cpuSupportsAvx2() { return __builtin_cpu_supports("avx2"); }
+static bool cpuSupportsAvx512() { return __builtin_cpu_supports("avx512f"); }
+#endif
+#endif
+
+RainKernel selectRainKernel(const unsigned features) {
+#ifdef MATRIX_RAIN_X86
+    if (cpuSupportsAvx512()) {
+        return rainKernelAvx512(features);
+    }
+    if (cpuSupportsAvx2()) {
+        return rainKernelAvx2(features);
+    }
+    return rainKernelSse2(features);
+#else
+    return rainKernelScalar(features);
+#endif
+}
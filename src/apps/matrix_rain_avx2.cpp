@@ -0,0 +1,61 @@
+#include "apps/matrix_rain_kernel.h"
+#include <immintrin.h>
+
+namespace {
+struct Avx2Lanes {
+    static constexpr int width = 8;
+    using F = __m256;
+    using I = __m256i;
+    using M = __m256;
+
+    static F load(const float *p) { return _mm256_load_ps(p); }
+    static void store(float *p, const F v) { _mm256_store_ps(p, v); }
+    static void storeu(float *p, const F v) { _mm256_storeu_ps(p, v); }
+    static I loadi(const int *p) { return _mm256_load_si256(reinterpret_cast<const __m256i *>(p)); }
+    static void storei(int *p, const I v) { _mm256_store_si256(reinterpret_cast<__m256i *>(p), v); }
+    static F set1(const float v) { return _mm256_set1_ps(v); }
+    static I set1i(const int v) { return _mm256_set1_epi32(v); }
+
+    static F add(const F a, const F b) { return _mm256_add_ps(a, b); }
+    static F sub(const F a, const F b) { return _mm256_sub_ps(a, b); }
+    static F mul(const F a, const F b) { return _mm256_mul_ps(a, b); }
+    static F div(const F a, const F b) { return _mm256_div_ps(a, b); }
+    static F sqrt(const F a) { return _mm256_sqrt_ps(a); }
+
+    static M lt(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M ge(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M ne(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static M eqi(const I a, const I b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+    static M gti(const I a, const I b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)); }
+    static M test(const I a, const int bit) { return eqi(_mm256_and_si256(a, _mm256_set1_epi32(bit)), _mm256_set1_epi32(bit)); }
+
+    static M and_(const M a, const M b) { return _mm256_and_ps(a, b); }
+    static M or_(const M a, const M b) { return _mm256_or_ps(a, b); }
+    static M andnot(const M a, const M b) { return _mm256_andnot_ps(b, a); }
+    static F select(const M m, const F t, const F f) { return _mm256_blendv_ps(f, t, m); }
+    static I decrement(const I a, const M m) { return _mm256_add_epi32(a, _mm256_castps_si256(m)); }
+    static unsigned bits(const M m) { return _mm256_movemask_ps(m); }
+
+    static void storeInstances(RainDrawData *out, const F x, const F y, const F colorOffset, const I spark) {
+        // Transpose 4x4 inside each 128-bit half, then the halves hold raindrops i..i+3 and i+4..i+7
+        const F sparkBits = _mm256_castsi256_ps(spark);
+        const F t0 = _mm256_unpacklo_ps(x, y);
+        const F t1 = _mm256_unpacklo_ps(colorOffset, sparkBits);
+        const F t2 = _mm256_unpackhi_ps(x, y);
+        const F t3 = _mm256_unpackhi_ps(colorOffset, sparkBits);
+        const F r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        const F r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        const F r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        const F r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        auto *dst = reinterpret_cast<float *>(out);
+        _mm256_storeu_ps(dst, _mm256_permute2f128_ps(r0, r1, 0x20));
+        _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(r2, r3, 0x20));
+        _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(r0, r1, 0x31));
+        _mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(r2, r3, 0x31));
+    }
+};
+} // namespace
+
+RainKernel rainKernelAvx2(const unsigned features) {
+    return rainKernelWith<Avx2Lanes>(features);
+}
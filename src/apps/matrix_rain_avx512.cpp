@@ -0,0 +1,65 @@
+#include "apps/matrix_rain_kernel.h"
+#include <immintrin.h>
+
+namespace {
+struct Avx512Lanes {
+    static constexpr int width = 16;
+    using F = __m512;
+    using I = __m512i;
+    using M = __mmask16;
+
+    static F load(const float *p) { return _mm512_load_ps(p); }
+    static void store(float *p, const F v) { _mm512_store_ps(p, v); }
+    static void storeu(float *p, const F v) { _mm512_storeu_ps(p, v); }
+    static I loadi(const int *p) { return _mm512_load_si512(p); }
+    static void storei(int *p, const I v) { _mm512_store_si512(p, v); }
+    static F set1(const float v) { return _mm512_set1_ps(v); }
+    static I set1i(const int v) { return _mm512_set1_epi32(v); }
+
+    static F add(const F a, const F b) { return _mm512_add_ps(a, b); }
+    static F sub(const F a, const F b) { return _mm512_sub_ps(a, b); }
+    static F mul(const F a, const F b) { return _mm512_mul_ps(a, b); }
+    static F div(const F a, const F b) { return _mm512_div_ps(a, b); }
+    static F sqrt(const F a) { return _mm512_sqrt_ps(a); }
+
+    static M lt(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M ge(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M ne(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+    static M eqi(const I a, const I b) { return _mm512_cmpeq_epi32_mask(a, b); }
+    static M gti(const I a, const I b) { return _mm512_cmpgt_epi32_mask(a, b); }
+    static M test(const I a, const int bit) { return _mm512_test_epi32_mask(a, _mm512_set1_epi32(bit)); }
+
+    static M and_(const M a, const M b) { return a & b; }
+    static M or_(const M a, const M b) { return a | b; }
+    static M andnot(const M a, const M b) { return a & ~b; }
+    static F select(const M m, const F t, const F f) { return _mm512_mask_blend_ps(m, f, t); }
+    static I decrement(const I a, const M m) { return _mm512_mask_sub_epi32(a, m, a, _mm512_set1_epi32(1)); }
+    static unsigned bits(const M m) { return m; }
+
+    static void storeInstances(RainDrawData *out, const F x, const F y, const F colorOffset, const I spark) {
+        // Transpose 4x4 inside each 128-bit lane, then gather lane n of every row for raindrops i+4n..i+4n+3
+        const F sparkBits = _mm512_castsi512_ps(spark);
+        const F t0 = _mm512_unpacklo_ps(x, y);
+        const F t1 = _mm512_unpacklo_ps(colorOffset, sparkBits);
+        const F t2 = _mm512_unpackhi_ps(x, y);
+        const F t3 = _mm512_unpackhi_ps(colorOffset, sparkBits);
+        const F r0 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        const F r1 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        const F r2 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        const F r3 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        const F low01 = _mm512_shuffle_f32x4(r0, r1, _MM_SHUFFLE(1, 0, 1, 0));
+        const F low23 = _mm512_shuffle_f32x4(r2, r3, _MM_SHUFFLE(1, 0, 1, 0));
+        const F high01 = _mm512_shuffle_f32x4(r0, r1, _MM_SHUFFLE(3, 2, 3, 2));
+        const F high23 = _mm512_shuffle_f32x4(r2, r3, _MM_SHUFFLE(3, 2, 3, 2));
+        auto *dst = reinterpret_cast<float *>(out);
+        _mm512_storeu_ps(dst, _mm512_shuffle_f32x4(low01, low23, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm512_storeu_ps(dst + 16, _mm512_shuffle_f32x4(low01, low23, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm512_storeu_ps(dst + 32, _mm512_shuffle_f32x4(high01, high23, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm512_storeu_ps(dst + 48, _mm512_shuffle_f32x4(high01, high23, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+};
+} // namespace
+
+RainKernel rainKernelAvx512(const unsigned features) {
+    return rainKernelWith<Avx512Lanes>(features);
+}
@@ -0,0 +1,77 @@
+#include "apps/matrix_rain_grid.h"
+#include <cmath>
+
+void RainGrid::resize(const float width, const float height, const float cellSize, const int count) {
+    this->cellSize = std::max(cellSize, 1.0f);
+    columns = std::max(1, static_cast<int>(std::ceil(width / this->cellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height / this->cellSize)));
+    heads.assign(columns * rows, -1);
+    next.assign(count, -1);
+    previous.assign(count, -1);
+    cells.assign(count, -1);
+}
+
+void RainGrid::link(const int index, const int cell) {
+    cells[index] = cell;
+    previous[index] = -1;
+    next[index] = heads[cell];
+    if (heads[cell] != -1) {
+        previous[heads[cell]] = index;
+    }
+    heads[cell] = index;
+}
+
+void RainGrid::unlink(const int index) {
+    if (previous[index] != -1) {
+        next[previous[index]] = next[index];
+    } else {
+        heads[cells[index]] = next[index];
+    }
+    if (next[index] != -1) {
+        previous[next[index]] = previous[index];
+    }
+}
+
+void RainGrid::collect(const RainStore &rain, const int begin, const int end, std::vector<int> &moved) const {
+    // Most raindrops stay in their cell between ticks, only the ones that crossed a border are relinked
+    for (int i = begin; i < end; ++i) {
+        if (cell(rain.x[i], rain.y[i]) != cells[i]) {
+            moved.push_back(i);
+        }
+    }
+}
+
+void RainGrid::relink(const RainStore &rain, const std::vector<int> &moved) {
+    for (const int i : moved) {
+        if (cells[i] != -1) {
+            unlink(i);
+        }
+        link(i, cell(rain.x[i], rain.y[i]));
+    }
+}
+
+void pushRain(RainStore &rain, const RainGrid &grid, const RainFrame &frame, const int count, std::vector<int> *pushed) {
+    const float radius = frame.cursorRadius;
+    for (int c = 0; c < frame.cursorCount; ++c) {
+        const RainCursor cursor = frame.cursors[c];
+        grid.query(cursor.x, cursor.y, radius, [&](const int i) {
+            // Pardoned raindrops are still expanding and the miss roll lets a few slip through
+            if (i >= count || rain.pardons[i] > 0 || (rain.rolls[i] & (RAIN_CURSOR_MISS | RAIN_PUSHED)) != 0) {
+                return;
+            }
+            const float dx = rain.x[i] - cursor.x;
+            const float dy = rain.y[i] - cursor.y;
+            const float distance = std::sqrt(dx * dx + dy * dy);
+            if (!(distance < radius)) {
+                return;
+            }
+            const float force = (radius - distance) / radius;
+            rain.forceX[i] = dx / distance * force * 100.0f;
+            rain.forceY[i] = dy / distance * force * 100.0f;
+            rain.rolls[i] |= RAIN_PUSHED;
+            if (pushed != nullptr) {
+                pushed->push_back(i);
+            }
+        });
+    }
+}
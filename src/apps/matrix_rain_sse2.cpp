@@ -0,0 +1,53 @@
+#include "apps/matrix_rain_kernel.h"
+#include <emmintrin.h>
+
+namespace {
+struct Sse2Lanes {
+    static constexpr int width = 4;
+    using F = __m128;
+    using I = __m128i;
+    using M = __m128;
+
+    static F load(const float *p) { return _mm_load_ps(p); }
+    static void store(float *p, const F v) { _mm_store_ps(p, v); }
+    static void storeu(float *p, const F v) { _mm_storeu_ps(p, v); }
+    static I loadi(const int *p) { return _mm_load_si128(reinterpret_cast<const __m128i *>(p)); }
+    static void storei(int *p, const I v) { _mm_store_si128(reinterpret_cast<__m128i *>(p), v); }
+    static F set1(const float v) { return _mm_set1_ps(v); }
+    static I set1i(const int v) { return _mm_set1_epi32(v); }
+
+    static F add(const F a, const F b) { return _mm_add_ps(a, b); }
+    static F sub(const F a, const F b) { return _mm_sub_ps(a, b); }
+    static F mul(const F a, const F b) { return _mm_mul_ps(a, b); }
+    static F div(const F a, const F b) { return _mm_div_ps(a, b); }
+    static F sqrt(const F a) { return _mm_sqrt_ps(a); }
+
+    static M lt(const F a, const F b) { return _mm_cmplt_ps(a, b); }
+    static M ge(const F a, const F b) { return _mm_cmpge_ps(a, b); }
+    static M ne(const F a, const F b) { return _mm_cmpneq_ps(a, b); }
+    static M eqi(const I a, const I b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+    static M gti(const I a, const I b) { return _mm_castsi128_ps(_mm_cmpgt_epi32(a, b)); }
+    static M test(const I a, const int bit) { return eqi(_mm_and_si128(a, _mm_set1_epi32(bit)), _mm_set1_epi32(bit)); }
+
+    static M and_(const M a, const M b) { return _mm_and_ps(a, b); }
+    static M or_(const M a, const M b) { return _mm_or_ps(a, b); }
+    static M andnot(const M a, const M b) { return _mm_andnot_ps(b, a); }
+    static F select(const M m, const F t, const F f) { return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f)); }
+    static I decrement(const I a, const M m) { return _mm_add_epi32(a, _mm_castps_si128(m)); }
+    static unsigned bits(const M m) { return _mm_movemask_ps(m); }
+
+    static void storeInstances(RainDrawData *out, F x, F y, F colorOffset, const I spark) {
+        F sparkBits = _mm_castsi128_ps(spark);
+        _MM_TRANSPOSE4_PS(x, y, colorOffset, sparkBits);
+        auto *dst = reinterpret_cast<float *>(out);
+        _mm_storeu_ps(dst, x);
+        _mm_storeu_ps(dst + 4, y);
+        _mm_storeu_ps(dst + 8, colorOffset);
+        _mm_storeu_ps(dst + 12, sparkBits);
+    }
+};
+} // namespace
+
+RainKernel rainKernelSse2(const unsigned features) {
+    return rainKernelWith<Sse2Lanes>(features);
+}
@@ -0,0 +1,161 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The file starts with a header, every section is a record header followed by its aligned data
+struct checkpointFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sections;
+    uint32_t reserved;
+};
+
+struct checkpointRecord {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+static size_t recordOffset(const size_t end) {
+    // Place the record so the data after it lands on the alignment
+    const size_t data = (end + sizeof(checkpointRecord) + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+    return data - sizeof(checkpointRecord);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    wait();
+}
+
+void *CheckpointWriter::add(const uint32_t tag, const size_t size) {
+    if (data.empty()) {
+        data.resize(sizeof(checkpointFileHeader));
+    }
+    const size_t record = recordOffset(data.size());
+    data.resize(record + sizeof(checkpointRecord) + size);
+    const checkpointRecord header = {tag, 0, size};
+    memcpy(data.data() + record, &header, sizeof(header));
+    sections++;
+    return data.data() + record + sizeof(checkpointRecord);
+}
+
+void CheckpointWriter::add(const uint32_t tag, const void *data, const size_t size) {
+    memcpy(add(tag, size), data, size);
+}
+
+void CheckpointWriter::commit(const std::string &path) {
+    wait();
+    const checkpointFileHeader header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, sections, 0};
+    memcpy(data.data(), &header, sizeof(header));
+    sections = 0;
+
+    // The buffer moves to the worker, the next checkpoint starts from an empty one
+    worker = std::thread([path, contents = std::move(data)] {
+        const std::string temporary = path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        file.close();
+        if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cerr << "Could not write checkpoint " << path << std::endl;
+            std::remove(temporary.c_str());
+        }
+    });
+    data.clear();
+}
+
+void CheckpointWriter::wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+CheckpointReader::~CheckpointReader() {
+    close();
+}
+
+bool CheckpointReader::open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file || file.tellg() < static_cast<std::streamoff>(sizeof(checkpointFileHeader))) {
+        return false;
+    }
+    contents.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    mapped = contents.data();
+    mappedSize = contents.size();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(checkpointFileHeader))) {
+        ::close(fd);
+        return false;
+    }
+    void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    mapped = static_cast<const unsigned char *>(address);
+    mappedSize = info.st_size;
+#endif
+
+    checkpointFileHeader header{};
+    memcpy(&header, mapped, sizeof(header));
+    if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION) {
+        std::cerr << path << " is not a version " << CHECKPOINT_VERSION << " checkpoint" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CheckpointReader::close() {
+#ifdef _WIN32
+    contents.clear();
+#else
+    if (mapped != nullptr) {
+        munmap(const_cast<unsigned char *>(mapped), mappedSize);
+    }
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
+
+const void *CheckpointReader::section(const uint32_t tag, const size_t size) const {
+    if (mapped == nullptr) {
+        return nullptr;
+    }
+    checkpointFileHeader header{};
+    memcpy(&header, mapped, sizeof(header));
+    size_t end = sizeof(header);
+    for (uint32_t i = 0; i < header.sections; ++i) {
+        const size_t record = recordOffset(end);
+        if (record + sizeof(checkpointRecord) > mappedSize) {
+            return nullptr;
+        }
+        checkpointRecord entry{};
+        memcpy(&entry, mapped + record, sizeof(entry));
+        const size_t data = record + sizeof(checkpointRecord);
+        if (entry.size > mappedSize - data) {
+            return nullptr;
+        }
+        if (entry.tag == tag) {
+            return entry.size == size ? mapped + data : nullptr;
+        }
+        end = data + entry.size;
+    }
+    return nullptr;
+}
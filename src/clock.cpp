@@ -5,7 +5,12 @@ void tickRateClock::calculateDeltaTime() {
     const chrono_impl::duration<float> deltaTime = chrono_impl::duration_cast<chrono_impl::duration<float>>(
         currentTime - lastTime);
     this->lastTime = currentTime;
-    this->deltaTime = deltaTime.count();
+    advance(deltaTime.count());
+}
+
+void tickRateClock::advance(const float deltaTime) {
+    this->deltaTime = deltaTime;
+    elapsedTime += deltaTime;
 }
 
 void tickRateClock::calculateFrameSwapDeltaTime() {
@@ -18,6 +23,7 @@ void tickRateClock::calculateFrameSwapDeltaTime() {
 void tickRateClock::initialize() {
     this->lastTime = now();
     this->lastFrameSwapTime = now();
+    elapsedTime = 0.0;
 }
 
 void tickRateClock::resetFrameSwapTime() {
@@ -25,9 +31,7 @@ void tickRateClock::resetFrameSwapTime() {
 }
 
 float tickRateClock::floatTime() const {
-    const chrono_impl::steady_clock::time_point currentTime = now();
-    const chrono_impl::duration<float> elapsedTime = chrono_impl::duration_cast<chrono_impl::duration<float>>(currentTime.time_since_epoch());
-    return elapsedTime.count();
+    return static_cast<float>(elapsedTime);
 }
 
 chrono_impl::steady_clock::time_point tickRateClock::now() {
@@ -0,0 +1,115 @@
+#include "event_log.h"
+#include <events.h>
+#include <options.h>
+#include <cstdlib>
+#include <iostream>
+
+template<typename T>
+static void writeValue(std::ofstream &file, const T value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::ifstream &file, T &value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+static uint8_t packButtons(const eventLogFrame &frame) {
+    return (frame.mouseLeft ? 1 : 0) | (frame.mouseRight ? 2 : 0) | (frame.mouseMiddle ? 4 : 0);
+}
+
+void EventRecorder::open(const std::string &path, const options &opts) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not create event log " << path << std::endl;
+        exit(1);
+    }
+    writeValue<uint32_t>(file, EVENT_LOG_MAGIC);
+    writeValue<uint32_t>(file, EVENT_LOG_VERSION);
+    writeValue<uint64_t>(file, opts.seed.value_or(0));
+    writeValue<int32_t>(file, static_cast<int32_t>(opts.width));
+    writeValue<int32_t>(file, static_cast<int32_t>(opts.height));
+    previous = eventLogFrame();
+}
+
+void EventRecorder::write(const eventLogFrame &frame) {
+    uint8_t flags = frame.swapped ? EVENT_LOG_SWAPPED : 0;
+    if (frame.mouseX != previous.mouseX) flags |= EVENT_LOG_MOUSE_X;
+    if (frame.mouseY != previous.mouseY) flags |= EVENT_LOG_MOUSE_Y;
+    if (frame.keysPressed != previous.keysPressed) flags |= EVENT_LOG_KEYS;
+    if (packButtons(frame) != packButtons(previous)) flags |= EVENT_LOG_BUTTONS;
+    if (frame.quality != previous.quality) flags |= EVENT_LOG_QUALITY;
+
+    writeValue<uint8_t>(file, flags);
+    writeValue<float>(file, frame.deltaTime);
+    if (flags & EVENT_LOG_MOUSE_X) writeValue<int32_t>(file, static_cast<int32_t>(frame.mouseX));
+    if (flags & EVENT_LOG_MOUSE_Y) writeValue<int32_t>(file, static_cast<int32_t>(frame.mouseY));
+    if (flags & EVENT_LOG_KEYS) writeValue<int32_t>(file, static_cast<int32_t>(frame.keysPressed));
+    if (flags & EVENT_LOG_BUTTONS) writeValue<uint8_t>(file, packButtons(frame));
+    if (flags & EVENT_LOG_QUALITY) writeValue<uint8_t>(file, static_cast<uint8_t>(frame.quality));
+    previous = frame;
+}
+
+void EventRecorder::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void EventReplayer::open(const std::string &path, options &opts) {
+    file.open(path, std::ios::binary);
+    uint32_t magic = 0, version = 0;
+    uint64_t seed = 0;
+    int32_t width = 0, height = 0;
+    if (!file || !readValue(file, magic) || !readValue(file, version) || !readValue(file, seed) ||
+        !readValue(file, width) || !readValue(file, height)) {
+        std::cerr << "Could not read event log " << path << std::endl;
+        exit(1);
+    }
+    if (magic != EVENT_LOG_MAGIC || version != EVENT_LOG_VERSION) {
+        std::cerr << path << " is not a version " << EVENT_LOG_VERSION << " event log" << std::endl;
+        exit(1);
+    }
+
+    if (!opts.seed.has_value()) {
+        opts.seed = seed;
+    } else if (opts.seed.value() != seed) {
+        std::cerr << "Replaying with seed " << opts.seed.value() << " but the log was recorded with " << seed << std::endl;
+    }
+    if (opts.width != width || opts.height != height) {
+        std::cerr << "Replaying at " << opts.width << "x" << opts.height << " but the log was recorded at "
+                  << width << "x" << height << std::endl;
+    }
+    current = eventLogFrame();
+}
+
+bool EventReplayer::next() {
+    uint8_t flags = 0;
+    if (!readValue(file, flags) || !readValue(file, current.deltaTime)) {
+        return false;
+    }
+    current.swapped = flags & EVENT_LOG_SWAPPED;
+
+    int32_t value = 0;
+    uint8_t byte = 0;
+    if (flags & EVENT_LOG_MOUSE_X && readValue(file, value)) current.mouseX = value;
+    if (flags & EVENT_LOG_MOUSE_Y && readValue(file, value)) current.mouseY = value;
+    if (flags & EVENT_LOG_KEYS && readValue(file, value)) current.keysPressed = value;
+    if (flags & EVENT_LOG_BUTTONS && readValue(file, byte)) {
+        current.mouseLeft = byte & 1;
+        current.mouseRight = byte & 2;
+        current.mouseMiddle = byte & 4;
+    }
+    if (flags & EVENT_LOG_QUALITY && readValue(file, byte)) current.quality = byte;
+    // A record cut short by a crash ends the replay instead of replaying half a frame
+    return static_cast<bool>(file);
+}
+
+void EventReplayer::apply(groupedEvents *events) const {
+    events->mouseX = current.mouseX;
+    events->mouseY = current.mouseY;
+    events->keysPressed = current.keysPressed;
+    events->mouseLeft = current.mouseLeft;
+    events->mouseRight = current.mouseRight;
+    events->mouseMiddle = current.mouseMiddle;
+}
@@ -0,0 +1,293 @@
+#include "font_atlas_builder.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+// Android has no --font to rasterize, it is built without stb
+#ifndef __ANDROID__
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb_truetype.h>
+#endif
+
+std::vector<uint32_t> decodeUtf8(const std::string &text) {
+    std::vector<uint32_t> codepoints;
+    for (size_t i = 0; i < text.size();) {
+        const auto lead = static_cast<unsigned char>(text[i]);
+        const int length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+        uint32_t codepoint = length == 1 ? lead : lead & (0x3F >> (length - 1));
+        for (int j = 1; j < length && i + j < text.size(); ++j) {
+            codepoint = codepoint << 6 | (static_cast<unsigned char>(text[i + j]) & 0x3F);
+        }
+        codepoints.push_back(codepoint);
+        i += length;
+    }
+    return codepoints;
+}
+
+#ifndef __ANDROID__
+struct skylineSegment {
+    int x, y, width;
+};
+
+// Bottom left skyline packing, top left here since the atlas rows run from the top: every rectangle goes
+// where its bottom edge ends up highest, the skyline follows the lowest edge placed over each column
+class Skyline {
+public:
+    explicit Skyline(const int width) : segments{{0, 0, width}}, width(width) {}
+
+    bool place(const int w, const int h, int &x, int &y) {
+        int best = -1, bestBottom = 0;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            int top;
+            if (fits(i, w, top) && (best < 0 || top + h < bestBottom)) {
+                best = static_cast<int>(i);
+                bestBottom = top + h;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        x = segments[best].x;
+        y = bestBottom - h;
+        add(best, {x, bestBottom, w});
+        return true;
+    }
+
+private:
+    // Where a rectangle starting at segment i rests, it sits on the lowest of the segments it spans
+    bool fits(const size_t i, const int w, int &top) const {
+        if (segments[i].x + w > width) {
+            return false;
+        }
+        top = 0;
+        int remaining = w;
+        for (size_t j = i; remaining > 0; ++j) {
+            top = std::max(top, segments[j].y);
+            remaining -= segments[j].width;
+        }
+        return true;
+    }
+
+    void add(const int index, const skylineSegment segment) {
+        segments.insert(segments.begin() + index, segment);
+        // Trim the segments the new one now covers
+        const int end = segment.x + segment.width;
+        for (size_t i = index + 1; i < segments.size() && segments[i].x < end;) {
+            const int shrink = end - segments[i].x;
+            if (segments[i].width <= shrink) {
+                segments.erase(segments.begin() + i);
+                continue;
+            }
+            segments[i].x += shrink;
+            segments[i].width -= shrink;
+            break;
+        }
+        // And merge neighbours at the same height
+        for (size_t i = 0; i + 1 < segments.size();) {
+            if (segments[i].y == segments[i + 1].y) {
+                segments[i].width += segments[i + 1].width;
+                segments.erase(segments.begin() + i + 1);
+                continue;
+            }
+            ++i;
+        }
+    }
+
+    std::vector<skylineSegment> segments;
+    int width;
+};
+
+struct glyphRectangle {
+    int width, height;  // Padding included
+    int x, y;
+    int inkX, inkY;  // Where the ink goes inside the padding
+};
+
+// The height of the atlas the rectangles pack into at width, or -1 when one is wider
+static int packRectangles(std::vector<glyphRectangle> &rectangles, const std::vector<size_t> &order, const int width) {
+    Skyline skyline(width);
+    int height = 0;
+    for (const size_t i : order) {
+        glyphRectangle &rectangle = rectangles[i];
+        if (!skyline.place(rectangle.width, rectangle.height, rectangle.x, rectangle.y)) {
+            return -1;
+        }
+        height = std::max(height, rectangle.y + rectangle.height);
+    }
+    return height;
+}
+
+// Untrimmed cells are size tall with the line from the ascent to the descent squeezed into them
+static int cellBaseline(const stbtt_fontinfo &info, const int size) {
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+    return ascent > descent ? static_cast<int>(std::lround(static_cast<double>(size) * ascent / (ascent - descent))) : size;
+}
+
+// Untrimmed cells are as wide as the advance
+static int cellWidth(const stbtt_fontinfo &info, const int codepoint, const float scale) {
+    int advance, bearing;
+    stbtt_GetCodepointHMetrics(&info, codepoint, &advance, &bearing);
+    return std::max(static_cast<int>(std::lround(advance * scale)), 1);
+}
+
+// Rasterizes the ink inside box at inkX, inkY of a width by height cell starting at destination, ink reaching
+// past the advance or the line is cut off at the cell
+static void drawGlyph(const stbtt_fontinfo &info, const int codepoint, const float scale, const int *box,
+                      const int inkX, const int inkY, const int width, const int height, unsigned char *destination,
+                      const int stride, std::vector<unsigned char> &ink) {
+    const int inkWidth = box[2] - box[0], inkHeight = box[3] - box[1];
+    if (inkWidth <= 0 || inkHeight <= 0) {
+        return;
+    }
+    ink.assign(static_cast<size_t>(inkWidth) * inkHeight, 0);
+    stbtt_MakeCodepointBitmap(&info, ink.data(), inkWidth, inkHeight, inkWidth, scale, scale, codepoint);
+    for (int y = std::max(0, -inkY); y < inkHeight && inkY + y < height; ++y) {
+        for (int x = std::max(0, -inkX); x < inkWidth && inkX + x < width; ++x) {
+            destination[(inkY + y) * stride + inkX + x] = ink[y * inkWidth + x];
+        }
+    }
+}
+
+bool buildFontAtlas(const std::vector<unsigned char> &font, const std::vector<uint32_t> &codepoints, const int size,
+                    const int padding, const bool trim, builtFontAtlas &atlas) {
+    stbtt_fontinfo info;
+    if (font.empty() || stbtt_GetFontOffsetForIndex(font.data(), 0) < 0 ||
+        !stbtt_InitFont(&info, font.data(), stbtt_GetFontOffsetForIndex(font.data(), 0))) {
+        std::cerr << "Couldn't read the font" << std::endl;
+        return false;
+    }
+    // Pixels per em, the way the font size was always given
+    const float scale = stbtt_ScaleForMappingEmToPixels(&info, static_cast<float>(size));
+    const int baseline = cellBaseline(info, size);
+
+    std::vector<glyphRectangle> rectangles(codepoints.size());
+    std::vector<int> boxes(codepoints.size() * 4);
+    // Codepoints the font has no glyph for get an empty cell instead of its .notdef box
+    std::vector<bool> present(codepoints.size());
+    int area = 0, widest = 1, missing = 0;
+    for (size_t i = 0; i < codepoints.size(); ++i) {
+        const int codepoint = static_cast<int>(codepoints[i]);
+        present[i] = stbtt_FindGlyphIndex(&info, codepoint) != 0;
+        if (!present[i]) {
+            ++missing;
+            continue;
+        }
+        int *box = &boxes[i * 4];
+        stbtt_GetCodepointBitmapBox(&info, codepoint, scale, scale, &box[0], &box[1], &box[2], &box[3]);
+        glyphRectangle &rectangle = rectangles[i];
+        if (trim) {
+            // A glyph without ink still gets a cell so its index stays valid
+            rectangle.width = std::max(box[2] - box[0], 1);
+            rectangle.height = std::max(box[3] - box[1], 1);
+            rectangle.inkX = 0;
+            rectangle.inkY = 0;
+        } else {
+            rectangle.width = cellWidth(info, codepoint, scale);
+            rectangle.height = size;
+            rectangle.inkX = box[0];
+            rectangle.inkY = baseline + box[1];
+        }
+        rectangle.width += padding * 2;
+        rectangle.height += padding * 2;
+        area += rectangle.width * rectangle.height;
+        widest = std::max(widest, rectangle.width);
+    }
+
+    // Tallest first keeps the skyline flat, then every width up to a 2:1 atlas is tried for the least area
+    std::vector<size_t> order;
+    for (size_t i = 0; i < codepoints.size(); ++i) {
+        if (present[i]) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return rectangles[a].height > rectangles[b].height;
+    });
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(area))));
+    int bestWidth = 0, bestHeight = 0;
+    for (int width = std::max(widest, side / 2); width <= std::max(widest, side * 2); ++width) {
+        const int height = packRectangles(rectangles, order, width);
+        if (height > 0 && (bestWidth == 0 || width * height < bestWidth * bestHeight)) {
+            bestWidth = width;
+            bestHeight = height;
+        }
+    }
+    if (bestWidth == 0) {
+        // None of them are in the font
+        bestWidth = 1;
+        bestHeight = 1;
+    }
+    packRectangles(rectangles, order, bestWidth);
+    if (missing > 0) {
+        std::cerr << missing << " of " << codepoints.size() << " characters aren't in the font" << std::endl;
+    }
+
+    atlas.width = bestWidth;
+    atlas.height = bestHeight;
+    atlas.size = size;
+    atlas.pixels.assign(static_cast<size_t>(bestWidth) * bestHeight, 0);
+    atlas.characters.resize(codepoints.size());
+    std::vector<unsigned char> ink;
+    for (size_t i = 0; i < codepoints.size(); ++i) {
+        if (!present[i]) {
+            atlas.characters[i] = {0, 0, 0, 0};
+            continue;
+        }
+        const glyphRectangle &rectangle = rectangles[i];
+        drawGlyph(info, static_cast<int>(codepoints[i]), scale, &boxes[i * 4], rectangle.inkX, rectangle.inkY,
+                  rectangle.width - padding * 2, rectangle.height - padding * 2,
+                  &atlas.pixels[(rectangle.y + padding) * bestWidth + rectangle.x + padding], bestWidth, ink);
+        atlas.characters[i] = {
+            static_cast<unsigned int>(rectangle.x),
+            static_cast<unsigned int>(bestHeight - rectangle.y - rectangle.height),
+            static_cast<unsigned int>(rectangle.width),
+            static_cast<unsigned int>(rectangle.height)
+        };
+    }
+    return true;
+}
+
+GlyphRasterizer::GlyphRasterizer() = default;
+GlyphRasterizer::~GlyphRasterizer() = default;
+
+bool GlyphRasterizer::open(std::vector<unsigned char> data, const int pixels, const int padding) {
+    font = std::move(data);
+    info = std::make_unique<stbtt_fontinfo>();
+    if (font.empty() || stbtt_GetFontOffsetForIndex(font.data(), 0) < 0 ||
+        !stbtt_InitFont(info.get(), font.data(), stbtt_GetFontOffsetForIndex(font.data(), 0))) {
+        std::cerr << "Couldn't read the font" << std::endl;
+        info.reset();
+        return false;
+    }
+    size = pixels;
+    margin = padding;
+    scale = stbtt_ScaleForMappingEmToPixels(info.get(), static_cast<float>(size));
+    baseline = cellBaseline(*info, size);
+    return true;
+}
+
+int GlyphRasterizer::widestCell() const {
+    int x0, y0, x1, y1;
+    stbtt_GetFontBoundingBox(info.get(), &x0, &y0, &x1, &y1);
+    return std::max(static_cast<int>(std::ceil((x1 - x0) * scale)), size) + margin * 2;
+}
+
+bool GlyphRasterizer::rasterize(const uint32_t codepoint, glyphBitmap &glyph) const {
+    if (info == nullptr || stbtt_FindGlyphIndex(info.get(), static_cast<int>(codepoint)) == 0) {
+        return false;
+    }
+    int box[4];
+    stbtt_GetCodepointBitmapBox(info.get(), static_cast<int>(codepoint), scale, scale, &box[0], &box[1], &box[2],
+                                &box[3]);
+    const int width = cellWidth(*info, static_cast<int>(codepoint), scale);
+    glyph.width = width + margin * 2;
+    glyph.height = size + margin * 2;
+    glyph.pixels.assign(static_cast<size_t>(glyph.width) * glyph.height, 0);
+    std::vector<unsigned char> ink;
+    drawGlyph(*info, static_cast<int>(codepoint), scale, box, box[0], baseline + box[1], width, size,
+              &glyph.pixels[margin * glyph.width + margin], glyph.width, ink);
+    return true;
+}
+#endif
@@ -1,73 +1,346 @@
 #include "fonts.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <font_atlas_builder.h>
+#include <fstream>
 #include <gl_errors.h>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
-void FontAtlas::destroy() const {
-    GL_CHECK(glDeleteBuffers(1, &glyphBuffer));
-    GL_CHECK(glDeleteTextures(1, &glyphTexture));
+#ifndef __ANDROID__
+#include "glad.h"
+#endif
+
+#define FONT_CACHE_MAGIC 0x4146584D  // "MXFA"
+
+// A cached atlas is this header, the characters and then the texels
+struct fontCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t size;
+    uint32_t characterCount;
+};
+
+// Squared distance from every sample of f to the nearest feature, where features are 0 and the rest is infinite.
+// The lower envelope of parabolas from Felzenszwalb and Huttenlocher, exact in O(n)
+static void distanceTransform(std::vector<float> &f, const int offset, const int stride, const int n,
+                              std::vector<float> &d, std::vector<int> &v, std::vector<float> &z) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    auto at = [&](const int i) -> float & { return f[offset + i * stride]; };
+    int k = 0;
+    v[0] = 0;
+    z[0] = -infinity;
+    z[1] = infinity;
+    for (int q = 1; q < n; ++q) {
+        if (at(q) == infinity) {
+            continue;
+        }
+        if (at(v[k]) == infinity) {
+            v[k] = q;
+            continue;
+        }
+        float s;
+        while ((s = ((at(q) + q * q) - (at(v[k]) + v[k] * v[k])) / (2.0f * (q - v[k]))) <= z[k]) {
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = infinity;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        d[q] = at(v[k]) == infinity ? infinity : (q - v[k]) * (q - v[k]) + at(v[k]);
+    }
+    for (int q = 0; q < n; ++q) {
+        at(q) = d[q];
+    }
 }
 
-FontAtlas *createFontTextureAtlas(const unsigned char *source, const FontInfo *fontInfo) {
-    // Create a texture atlas
-    GLuint glyphTexture, glyphBuffer;
-    GL_CHECK(glGenBuffers(1, &glyphBuffer));
-    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, glyphBuffer));
-    GL_CHECK(
-        glBufferData(GL_UNIFORM_BUFFER, fontInfo->characterCount * sizeof(CharacterInfo), fontInfo->characterInfoList,
-            GL_STATIC_DRAW));
-
-    GL_CHECK(glGenTextures(1, &glyphTexture));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, glyphTexture));
-
-    // Set texture parameters
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-
-#ifdef __ANDROID__
-    // Set swizzle mask so single R channel is readable in shader
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
-    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_RED));
-#endif
+// Squared distance from every texel of a width by height cell to the nearest texel where inside matches
+static std::vector<float> distanceToNearest(const std::vector<bool> &inside, const bool match, const int width,
+                                           const int height) {
+    std::vector<float> f(inside.size());
+    for (size_t i = 0; i < inside.size(); ++i) {
+        f[i] = inside[i] == match ? 0.0f : std::numeric_limits<float>::infinity();
+    }
+    const int longest = std::max(width, height);
+    std::vector<float> d(longest), z(longest + 1);
+    std::vector<int> v(longest);
+    for (int x = 0; x < width; ++x) {
+        distanceTransform(f, x, width, height, d, v, z);
+    }
+    for (int y = 0; y < height; ++y) {
+        distanceTransform(f, y * width, 1, width, d, v, z);
+    }
+    return f;
+}
+
+// The cell on its own, the cells of the embedded atlas are packed edge to edge so one glyph must not reach into the next
+static void createDistanceField(glyphBitmap &glyph) {
+    const int width = glyph.width, height = glyph.height;
+    std::vector<bool> inside(glyph.pixels.size());
+    for (size_t i = 0; i < glyph.pixels.size(); ++i) {
+        inside[i] = glyph.pixels[i] >= 128;
+    }
+    const std::vector<float> outsideDistance = distanceToNearest(inside, true, width, height);
+    const std::vector<float> insideDistance = distanceToNearest(inside, false, width, height);
+    for (int texel = 0; texel < width * height; ++texel) {
+        // The edge runs half a texel from the centres on either side of it
+        const float distance = inside[texel] ? 0.5f - std::sqrt(insideDistance[texel])
+                                             : std::sqrt(outsideDistance[texel]) - 0.5f;
+        const float value = std::clamp(0.5f - distance / (2.0f * FONT_DISTANCE_FIELD_SPREAD), 0.0f, 1.0f);
+        glyph.pixels[texel] = static_cast<unsigned char>(std::lround(value * 255.0f));
+    }
+}
+
+// Cuts the cells out of a whole atlas, the embedded one or one read from the disk cache
+class AtlasGlyphSource final : public GlyphSource {
+public:
+    AtlasGlyphSource(const unsigned char *source, const FontInfo *fontInfo, const std::vector<uint32_t> &codepoints,
+                     const bool distanceField)
+        : pixels(source, source + static_cast<size_t>(fontInfo->width) * fontInfo->height),
+          width(fontInfo->width), height(fontInfo->height),
+          characters(fontInfo->characterInfoList, fontInfo->characterInfoList + fontInfo->characterCount) {
+        size = fontInfo->size;
+        this->distanceField = distanceField;
+        for (int i = 0; i < fontInfo->characterCount && i < static_cast<int>(codepoints.size()); ++i) {
+            // An empty cell is a character the font doesn't have
+            if (characters[i].width == 0 || characters[i].height == 0) {
+                continue;
+            }
+            indices.emplace(codepoints[i], i);
+            cellWidth = std::max(cellWidth, static_cast<int>(characters[i].width));
+            cellHeight = std::max(cellHeight, static_cast<int>(characters[i].height));
+        }
+    }
+
+    bool rasterize(const uint32_t codepoint, glyphBitmap &glyph) override {
+        const auto found = indices.find(codepoint);
+        if (found == indices.end()) {
+            return false;
+        }
+        const CharacterInfo &character = characters[found->second];
+        glyph.width = static_cast<int>(character.width);
+        glyph.height = static_cast<int>(character.height);
+        glyph.pixels.resize(static_cast<size_t>(glyph.width) * glyph.height);
+        // yOffset counts from the bottom of the atlas, the rows are stored from the top
+        const int top = height - static_cast<int>(character.yOffset) - glyph.height;
+        for (int y = 0; y < glyph.height; ++y) {
+            memcpy(&glyph.pixels[y * glyph.width], &pixels[(top + y) * width + character.xOffset], glyph.width);
+        }
+        if (distanceField) {
+            createDistanceField(glyph);
+        }
+        return true;
+    }
+
+private:
+    std::vector<unsigned char> pixels;
+    int width, height;
+    std::vector<CharacterInfo> characters;
+    std::unordered_map<uint32_t, int> indices;
+};
+
+GlyphSource *createGlyphSource(const unsigned char *source, const FontInfo *fontInfo, const bool distanceField) {
+    return new AtlasGlyphSource(source, fontInfo, decodeUtf8(FONT_ATLAS_DEFAULT_CHARACTERS), distanceField);
+}
+
+// Android has no --font, only the embedded atlas
+#ifndef __ANDROID__
+// The cached atlas first, everything else straight from the font
+class FontGlyphSource final : public GlyphSource {
+public:
+    FontGlyphSource(AtlasGlyphSource *atlas, std::unique_ptr<GlyphRasterizer> rasterizer, const int padding)
+        : atlas(atlas), rasterizer(std::move(rasterizer)) {
+        size = atlas->size;
+        distanceField = atlas->distanceField;
+        cellWidth = std::max(atlas->cellWidth, this->rasterizer->widestCell());
+        cellHeight = size + padding * 2;
+    }
+
+    bool rasterize(const uint32_t codepoint, glyphBitmap &glyph) override {
+        if (atlas->rasterize(codepoint, glyph)) {
+            return true;
+        }
+        if (!rasterizer->rasterize(codepoint, glyph)) {
+            return false;
+        }
+        if (distanceField) {
+            createDistanceField(glyph);
+        }
+        return true;
+    }
 
-    // Upload the atlas data to the texture
-    GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
-#ifdef __ANDROID__
-    // OpenGL ES 3.0 requires sized internal format
-    GL_CHECK(glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_R8,           // Sized internal format for ES
-        fontInfo->width,
-        fontInfo->height,
-        0,
-        GL_RED,          // Format of source data
-        GL_UNSIGNED_BYTE,
-        source
-    ));
+private:
+    std::unique_ptr<AtlasGlyphSource> atlas;
+    std::unique_ptr<GlyphRasterizer> rasterizer;
+};
+
+static uint64_t fnv1a(const void *data, const size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// $XDG_CACHE_HOME/matrix or ~/.cache/matrix, empty when neither is set and nothing is cached
+static std::filesystem::path fontCacheDirectory() {
+    if (const char *cache = getenv("XDG_CACHE_HOME"); cache != nullptr && cache[0] != '\0') {
+        return std::filesystem::path(cache) / "matrix";
+    }
+    if (const char *home = getenv("HOME"); home != nullptr && home[0] != '\0') {
+        return std::filesystem::path(home) / ".cache" / "matrix";
+    }
+    return {};
+}
+
+// Anything that doesn't match what would be built is rejected, so a truncated or stale file is rebuilt instead
+static bool readFontCache(const std::filesystem::path &path, const int size, const size_t characterCount,
+                          builtFontAtlas &atlas) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    const auto length = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    fontCacheHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != FONT_CACHE_MAGIC ||
+        header.version != FONT_CACHE_VERSION || header.size != static_cast<uint32_t>(size) ||
+        header.characterCount != characterCount) {
+        return false;
+    }
+    GLint maxSize;
+    GL_CHECK(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize));
+    if (header.width == 0 || header.height == 0 || header.width > static_cast<uint32_t>(maxSize) ||
+        header.height > static_cast<uint32_t>(maxSize) ||
+        length != sizeof(header) + static_cast<uint64_t>(header.characterCount) * sizeof(CharacterInfo) +
+                  static_cast<uint64_t>(header.width) * header.height) {
+        return false;
+    }
+    atlas.width = static_cast<int>(header.width);
+    atlas.height = static_cast<int>(header.height);
+    atlas.size = static_cast<int>(header.size);
+    atlas.characters.resize(header.characterCount);
+    atlas.pixels.resize(static_cast<size_t>(header.width) * header.height);
+    if (!file.read(reinterpret_cast<char *>(atlas.characters.data()),
+                   static_cast<std::streamsize>(atlas.characters.size() * sizeof(CharacterInfo))) ||
+        !file.read(reinterpret_cast<char *>(atlas.pixels.data()), static_cast<std::streamsize>(atlas.pixels.size()))) {
+        return false;
+    }
+    // The glyphs are cut out of the texels, every one has to be inside them
+    return std::all_of(atlas.characters.begin(), atlas.characters.end(), [&](const CharacterInfo &character) {
+        return character.xOffset <= header.width && character.width <= header.width - character.xOffset &&
+               character.yOffset <= header.height && character.height <= header.height - character.yOffset;
+    });
+}
+
+static void writeFontCache(const std::filesystem::path &path, const builtFontAtlas &atlas) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    // Written next to it and renamed, so a second instance never reads half a file
+    const std::filesystem::path temporary = path.string() + ".tmp";
+    std::ofstream file(temporary, std::ios::binary);
+    const fontCacheHeader header = {FONT_CACHE_MAGIC, FONT_CACHE_VERSION, static_cast<uint32_t>(atlas.width),
+        static_cast<uint32_t>(atlas.height), static_cast<uint32_t>(atlas.size),
+        static_cast<uint32_t>(atlas.characters.size())};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(atlas.characters.data()),
+               static_cast<std::streamsize>(atlas.characters.size() * sizeof(CharacterInfo)));
+    file.write(reinterpret_cast<const char *>(atlas.pixels.data()), static_cast<std::streamsize>(atlas.pixels.size()));
+    file.close();
+    if (!file) {
+        std::cerr << "Couldn't write the font cache " << temporary << std::endl;
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    std::filesystem::rename(temporary, path, error);
+}
+
+GlyphSource *createGlyphSource(const std::string &path, const int size, const bool distanceField) {
+    std::ifstream fontFile(path, std::ios::binary);
+    if (!fontFile || size <= 0) {
+        std::cerr << "Couldn't open the font " << path << ", using the embedded one" << std::endl;
+        return nullptr;
+    }
+    std::vector<unsigned char> font{std::istreambuf_iterator<char>(fontFile), std::istreambuf_iterator<char>()};
+    // The distance field needs room outside the glyphs to fall off in
+    const int padding = distanceField ? static_cast<int>(FONT_DISTANCE_FIELD_SPREAD) : FONT_ATLAS_DEFAULT_PADDING;
+
+    // Keyed by everything that goes into the atlas, a changed font or charset gets its own file
+    uint64_t key = fnv1a(font.data(), font.size());
+    key = fnv1a(FONT_ATLAS_DEFAULT_CHARACTERS, strlen(FONT_ATLAS_DEFAULT_CHARACTERS), key);
+    key = fnv1a(&padding, sizeof(padding), key);
+    char name[64];
+    snprintf(name, sizeof(name), "font-%016llx-%d.atlas", static_cast<unsigned long long>(key), size);
+    const std::filesystem::path directory = fontCacheDirectory();
+
+    const std::vector<uint32_t> characters = decodeUtf8(FONT_ATLAS_DEFAULT_CHARACTERS);
+    builtFontAtlas atlas;
+    if (directory.empty() || !readFontCache(directory / name, size, characters.size(), atlas)) {
+        if (!buildFontAtlas(font, characters, size, padding, false, atlas)) {
+            std::cerr << "Using the embedded font instead of " << path << std::endl;
+            return nullptr;
+        }
+        if (!directory.empty()) {
+            writeFontCache(directory / name, atlas);
+        }
+    }
+    auto rasterizer = std::make_unique<GlyphRasterizer>();
+    if (!rasterizer->open(std::move(font), size, padding)) {
+        return nullptr;
+    }
+    const FontInfo fontInfo = {atlas.width, atlas.height, atlas.size, static_cast<int>(atlas.characters.size()),
+        atlas.characters.data()};
+    return new FontGlyphSource(new AtlasGlyphSource(atlas.pixels.data(), &fontInfo, characters, distanceField),
+        std::move(rasterizer), padding);
+}
 #else
-    GL_CHECK(glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RED,
-        fontInfo->width,
-        fontInfo->height,
-        0,
-        GL_RED,
-        GL_UNSIGNED_BYTE,
-        source
-    ));
+GlyphSource *createGlyphSource(const std::string &path, int, bool) {
+    std::cerr << "Fonts can't be rasterized on Android, using the embedded one instead of " << path << std::endl;
+    return nullptr;
+}
 #endif
 
-    // Unbind the texture
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
-    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, 0));
-
+// Unicode ranges of the charsets besides the embedded one, a name can span several
+static const struct {
+    const char *name;
+    uint32_t first, last;
+} charsetRanges[] = {
+    {"katakana", 0xFF66, 0xFF9D},  // Half width, like the embedded ones
+    {"katakana", 0x30A1, 0x30FA},
+    {"kanji", 0x4E00, 0x9FFF},
+    {"latin", 0x21, 0x7E},
+    {"digits", 0x30, 0x39},
+};
 
-    return new FontAtlas{glyphTexture, glyphBuffer, static_cast<float>(fontInfo->width), static_cast<float>(fontInfo->height)};
+bool findCharset(const std::string &name, std::vector<uint32_t> &codepoints) {
+    codepoints.clear();
+    if (name == "matrix") {
+        codepoints = decodeUtf8(FONT_ATLAS_DEFAULT_CHARACTERS);
+        return true;
+    }
+    for (const auto &range : charsetRanges) {
+        if (name == range.name) {
+            for (uint32_t codepoint = range.first; codepoint <= range.last; ++codepoint) {
+                codepoints.push_back(codepoint);
+            }
+        }
+    }
+    return !codepoints.empty();
 }
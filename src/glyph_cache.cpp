@@ -0,0 +1,220 @@
+#include "glyph_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <gl_errors.h>
+#include <iostream>
+
+void GlyphCache::create(GlyphSource *glyphSource) {
+    source.reset(glyphSource);
+    size = source->size;
+    distanceField = source->distanceField;
+
+    GLint maxSize, maxLayers;
+    GL_CHECK(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize));
+    GL_CHECK(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+    pageSize = std::min(GLYPH_CACHE_PAGE_SIZE, static_cast<int>(maxSize));
+    const int pages = std::min(GLYPH_CACHE_PAGES, static_cast<int>(maxLayers));
+    // A cell larger than a page is cut off at it
+    slotWidth = std::min(source->cellWidth + GLYPH_CACHE_SLOT_GAP, pageSize);
+    slotHeight = std::min(source->cellHeight + GLYPH_CACHE_SLOT_GAP, pageSize);
+    columns = pageSize / slotWidth;
+    slotsPerPage = columns * (pageSize / slotHeight);
+    slots.assign(static_cast<size_t>(slotsPerPage) * pages, {});
+    shown.assign(slots.size(), false);
+
+    GL_CHECK(glGenTextures(1, &pageTexture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, pageTexture));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+#ifdef __ANDROID__
+    // Set swizzle mask so single R channel is readable in shader
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_R, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_A, GL_RED));
+#endif
+    // Every slot is written whole when a glyph moves in, so the pages start out cleared only once
+    const std::vector<unsigned char> clear(static_cast<size_t>(pageSize) * pageSize * pages, 0);
+    GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GL_CHECK(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, pageSize, pageSize, pages, 0, GL_RED, GL_UNSIGNED_BYTE,
+        clear.data()));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+
+    // Integer texels are never filtered
+    GL_CHECK(glGenTextures(1, &tableTexture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, tableTexture));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+void GlyphCache::destroy() {
+    GL_CHECK(glDeleteTextures(1, &pageTexture));
+    GL_CHECK(glDeleteTextures(1, &tableTexture));
+    source.reset();
+    slots.clear();
+    resident.clear();
+    absent.clear();
+    glyphs.clear();
+    pending = false;
+    shown.clear();
+}
+
+bool GlyphCache::setCharset(const std::vector<uint32_t> &codepoints) {
+    requestCharset(codepoints);
+    return update(-1);
+}
+
+void GlyphCache::requestCharset(const std::vector<uint32_t> &codepoints) {
+    ++stamp;
+    pending = true;
+    wanted.clear();
+    next = 0;
+    charset.clear();
+    charsetSlots.clear();
+    missing = 0;
+    dropped = 0;
+    std::unordered_set<uint32_t> seen;
+    for (const uint32_t codepoint : codepoints) {
+        if (seen.insert(codepoint).second) {
+            wanted.push_back(codepoint);
+        }
+    }
+    // The resident glyphs are claimed first so a miss never evicts one this charset uses
+    for (const uint32_t codepoint : wanted) {
+        if (const auto found = resident.find(codepoint); found != resident.end()) {
+            slots[found->second].lastUse = stamp;
+        }
+    }
+    // Free slots first, then the least recently used. The shown glyphs stay until the switch is done
+    victims.clear();
+    nextVictim = 0;
+    for (int i = 0; i < static_cast<int>(slots.size()); ++i) {
+        if (slots[i].lastUse < stamp && !shown[i]) {
+            victims.push_back(i);
+        }
+    }
+    std::stable_sort(victims.begin(), victims.end(), [&](const int a, const int b) {
+        return slots[a].lastUse < slots[b].lastUse;
+    });
+}
+
+bool GlyphCache::update(const int budget) {
+    if (!pending) {
+        return false;
+    }
+    int rasterized = 0;
+    glyphBitmap glyph;
+    for (; next < wanted.size(); ++next) {
+        const uint32_t codepoint = wanted[next];
+        int slot;
+        if (const auto found = resident.find(codepoint); found != resident.end()) {
+            slot = found->second;
+        } else if (absent.count(codepoint) != 0) {
+            continue;
+        } else if (nextVictim == victims.size()) {
+            ++dropped;
+            continue;
+        } else if (budget >= 0 && rasterized == budget) {
+            // Carries on from this glyph next update
+            return false;
+        } else {
+            ++rasterized;
+            if (!source->rasterize(codepoint, glyph)) {
+                absent.insert(codepoint);
+                ++missing;
+                continue;
+            }
+            slot = victims[nextVictim++];
+            if (slots[slot].lastUse != 0) {
+                resident.erase(slots[slot].codepoint);
+            }
+            uploadGlyph(slot, glyph);
+            slots[slot].codepoint = codepoint;
+            slots[slot].lastUse = stamp;
+            resident[codepoint] = slot;
+        }
+        charset.push_back(placeGlyph(slot));
+        charsetSlots.push_back(slot);
+    }
+    pending = false;
+    // Told once, the codepoints the font lacks are skipped quietly after that
+    if (missing > 0) {
+        std::cerr << "Glyph cache: " << missing << " of " << wanted.size() << " characters aren't in the font"
+                  << std::endl;
+    }
+    if (dropped > 0) {
+        std::cerr << "Glyph cache: no room for the last " << dropped << " of " << wanted.size() << " characters"
+                  << std::endl;
+    }
+    if (charset.empty()) {
+        return false;
+    }
+    glyphs = std::move(charset);
+    charset.clear();
+    shown.assign(slots.size(), false);
+    for (const int slot : charsetSlots) {
+        shown[slot] = true;
+    }
+    writeTable();
+    return true;
+}
+
+void GlyphCache::bind() const {
+    GL_CHECK(glActiveTexture(GL_TEXTURE0 + GLYPH_TABLE_TEXTURE_UNIT));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, tableTexture));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, pageTexture));
+}
+
+cachedGlyph GlyphCache::placeGlyph(const int slot) const {
+    const int index = slot % slotsPerPage;
+    const int top = index / columns * slotHeight;
+    return {
+        {
+            static_cast<unsigned int>(index % columns * slotWidth),
+            static_cast<unsigned int>(pageSize - top - slots[slot].height),
+            static_cast<unsigned int>(slots[slot].width),
+            static_cast<unsigned int>(slots[slot].height)
+        },
+        static_cast<unsigned int>(slot / slotsPerPage)
+    };
+}
+
+void GlyphCache::uploadGlyph(const int slot, const glyphBitmap &glyph) {
+    // The glyph goes in the top left with the gap right of and below it, the whole slot is written so nothing
+    // of the glyph it replaces is left around it
+    const int width = std::min(glyph.width, slotWidth - GLYPH_CACHE_SLOT_GAP);
+    const int height = std::min(glyph.height, slotHeight - GLYPH_CACHE_SLOT_GAP);
+    std::vector<unsigned char> texels(static_cast<size_t>(slotWidth) * slotHeight, 0);
+    for (int y = 0; y < height; ++y) {
+        memcpy(&texels[y * slotWidth], &glyph.pixels[y * glyph.width], width);
+    }
+    slots[slot].width = width;
+    slots[slot].height = height;
+
+    const int index = slot % slotsPerPage;
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, pageTexture));
+    GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GL_CHECK(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, index % columns * slotWidth, index / columns * slotHeight,
+        slot / slotsPerPage, slotWidth, slotHeight, 1, GL_RED, GL_UNSIGNED_BYTE, texels.data()));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+}
+
+void GlyphCache::writeTable() {
+    // xOffset | yOffset << 16, width | height << 16 and the layer, GLYPH_TABLE_WIDTH glyphs a row
+    const int rows = (static_cast<int>(glyphs.size()) + GLYPH_TABLE_WIDTH - 1) / GLYPH_TABLE_WIDTH;
+    std::vector<uint32_t> table(static_cast<size_t>(rows) * GLYPH_TABLE_WIDTH * 4, 0);
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        const cachedGlyph &glyph = glyphs[i];
+        table[i * 4] = glyph.character.xOffset | glyph.character.yOffset << 16;
+        table[i * 4 + 1] = glyph.character.width | glyph.character.height << 16;
+        table[i * 4 + 2] = glyph.layer;
+    }
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, tableTexture));
+    GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, GLYPH_TABLE_WIDTH, rows, 0, GL_RGBA_INTEGER,
+        GL_UNSIGNED_INT, table.data()));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
+}
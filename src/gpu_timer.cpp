@@ -0,0 +1,65 @@
+#include "gpu_timer.h"
+#include <gl_errors.h>
+#include <iostream>
+
+void GpuTimer::initialize(const char *name) {
+    this->name = name;
+#ifndef __ANDROID__
+    GL_CHECK(glGenQueries(GPU_TIMER_QUERIES * 2, queries[0]));
+#endif
+}
+
+void GpuTimer::destroy() {
+#ifndef __ANDROID__
+    GL_CHECK(glDeleteQueries(GPU_TIMER_QUERIES * 2, queries[0]));
+#endif
+}
+
+void GpuTimer::begin() {
+#ifndef __ANDROID__
+    // Skip timing this frame rather than reuse a query whose result has not come back yet
+    if (!queryPending[nextQuery]) {
+        GL_CHECK(glQueryCounter(queries[nextQuery][0], GL_TIMESTAMP));
+        queryActive = true;
+    }
+#endif
+}
+
+void GpuTimer::end() {
+#ifndef __ANDROID__
+    if (queryActive) {
+        GL_CHECK(glQueryCounter(queries[nextQuery][1], GL_TIMESTAMP));
+        queryPending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % GPU_TIMER_QUERIES;
+        queryActive = false;
+    }
+#endif
+}
+
+void GpuTimer::frameEnd() {
+#ifndef __ANDROID__
+    for (int i = 0; i < GPU_TIMER_QUERIES; ++i) {
+        if (!queryPending[i]) {
+            continue;
+        }
+        // The end timestamp is the later one, once it is there so is the start
+        GLuint available = GL_FALSE;
+        GL_CHECK(glGetQueryObjectuiv(queries[i][1], GL_QUERY_RESULT_AVAILABLE, &available));
+        if (!available) {
+            continue;
+        }
+        GLuint64 start = 0, end = 0;
+        GL_CHECK(glGetQueryObjectui64v(queries[i][0], GL_QUERY_RESULT, &start));
+        GL_CHECK(glGetQueryObjectui64v(queries[i][1], GL_QUERY_RESULT, &end));
+        time += static_cast<double>(end - start) / 1e9;
+        frames++;
+        queryPending[i] = false;
+    }
+#endif
+    if (frames < GPU_TIMER_REPORT_FRAMES) {
+        return;
+    }
+    std::cout << name << ": " << time / frames * 1000.0 << " ms GPU per frame" << std::endl;
+    time = 0.0;
+    frames = 0;
+}
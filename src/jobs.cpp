@@ -0,0 +1,120 @@
+#include "jobs.h"
+
+JobPool::JobPool(int threads) {
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // Queue 0 belongs to the calling thread
+    for (int i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(&JobPool::workerLoop, this, i);
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+int JobPool::threadCount() const {
+    return static_cast<int>(queues.size());
+}
+
+void JobPool::parallelFor(const int chunks, const std::function<void(int)> &job) {
+    if (workers.empty() || chunks <= 1) {
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            job(chunk);
+        }
+        return;
+    }
+
+    // Publish the job before any chunk becomes visible, taking a chunk then orders the read of job after this
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        remaining = chunks;
+    }
+
+    // Hand out contiguous runs so neighbouring chunks stay on the same core unless stolen
+    const int participants = threadCount();
+    for (int i = 0; i < participants; ++i) {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+        for (int chunk = chunks * i / participants; chunk < chunks * (i + 1) / participants; ++chunk) {
+            queues[i]->chunks.push_back(chunk);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0; });
+    this->job = nullptr;
+}
+
+bool JobPool::take(const int self, int &chunk) {
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        if (!queues[self]->chunks.empty()) {
+            chunk = queues[self]->chunks.back();
+            queues[self]->chunks.pop_back();
+            return true;
+        }
+    }
+
+    // Steal the oldest chunk of another thread
+    const int participants = threadCount();
+    for (int offset = 1; offset < participants; ++offset) {
+        Queue &victim = *queues[(self + offset) % participants];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobPool::work(const int self) {
+    int chunk;
+    while (take(self, chunk)) {
+        (*job)(chunk);
+        if (remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+}
+
+void JobPool::workerLoop(const int self) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) {
+                return;
+            }
+            seen = generation;
+        }
+        work(self);
+    }
+}
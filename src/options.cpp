@@ -1,7 +1,10 @@
 #include "options.h"
 
 #include "clock.h"
+#include "fonts.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <cstdio>
 #include <cstring>
@@ -20,6 +23,7 @@ void options::maskPostProcessingOptionsWithUserAllowed() {
 options* parseOptions(int argc, char *argv[]) {
     auto *opts = new options();
     bool hasSetApp = false;
+    bool hasSetCharset = false;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "-h" || arg == "--help") {
@@ -42,6 +46,67 @@ options* parseOptions(int argc, char *argv[]) {
             auto buffer = new char[256];
             sscanf(argv[i], "--image=%255s", buffer);
             opts->wallpaperImagePath = std::string(buffer);
+        } else if (arg.find("--seed=") == 0) {
+            opts->seed = strtoull(argv[i] + 7, nullptr, 10);
+        } else if (arg.find("--drops=") == 0) {
+            opts->drops = static_cast<int>(strtol(argv[i] + 8, nullptr, 10));
+        } else if (arg.find("--threads=") == 0) {
+            opts->threads = static_cast<int>(strtol(argv[i] + 10, nullptr, 10));
+        } else if (arg.find("--sim-rate=") == 0) {
+            opts->simRate = static_cast<int>(strtol(argv[i] + 11, nullptr, 10));
+        } else if (arg == "--gpu-rain") {
+            opts->gpuRain = true;
+        } else if (arg == "--analytic-rain") {
+            opts->analyticRain = true;
+        } else if (arg == "--compact-instances") {
+            opts->compactInstances = true;
+        } else if (arg == "--rain-up") {
+            opts->rainUp = true;
+        } else if (arg == "--no-interaction") {
+            opts->interaction = false;
+        } else if (arg == "--debug-layout") {
+            opts->debugLayout = true;
+        } else if (arg.find("--font=") == 0) {
+            opts->fontPath = std::string(argv[i] + 7);
+        } else if (arg.find("--charset=") == 0) {
+            opts->charsets.clear();
+            std::stringstream list(arg.substr(10));
+            std::string name;
+            std::vector<uint32_t> codepoints;
+            while (std::getline(list, name, ',')) {
+                if (!findCharset(name, codepoints)) {
+                    std::cerr << "Unknown charset: " << name << std::endl;
+                    exit(1);
+                }
+                opts->charsets.push_back(name);
+            }
+            hasSetCharset = true;
+        } else if (arg.find("--charset-text=") == 0) {
+            opts->charsetText = std::string(argv[i] + 15);
+        } else if (arg.find("--charset-time=") == 0) {
+            opts->charsetTime = std::max(0.0f, strtof(argv[i] + 15, nullptr));
+        } else if (arg == "--sdf") {
+            opts->distanceFieldGlyphs = true;
+        } else if (arg.find("--rotation=") == 0) {
+            opts->rotation = std::max(0, static_cast<int>(strtol(argv[i] + 11, nullptr, 10)));
+        } else if (arg.find("--trails=") == 0) {
+            opts->trails = static_cast<int>(strtol(argv[i] + 9, nullptr, 10));
+        } else if (arg == "--accumulate-ghosting") {
+            opts->accumulateGhosting = true;
+        } else if (arg == "--bloom") {
+            opts->userAllowedPostProcessingOptions |= BLOOM;
+        } else if (arg.find("--warmup=") == 0) {
+            opts->warmUp = std::max(0.0f, strtof(argv[i] + 9, nullptr));
+        } else if (arg == "--no-governor") {
+            opts->qualityGovernor = false;
+        } else if (arg.find("--checkpoint=") == 0) {
+            opts->checkpointPath = std::string(argv[i] + 13);
+        } else if (arg.find("--record=") == 0) {
+            opts->recordPath = std::string(argv[i] + 9);
+        } else if (arg.find("--replay=") == 0) {
+            opts->replayPath = std::string(argv[i] + 9);
+            // Replayed frames come as fast as they render, the log holds their timing
+            opts->loopWithSwap = false;
         } else {
             std::cerr << "Unknown argument: " << arg << std::endl;
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -49,6 +114,26 @@ options* parseOptions(int argc, char *argv[]) {
             exit(1);
         }
     }
+    if (opts->analyticRain && opts->gpuRain) {
+        std::cerr << "--analytic-rain and --gpu-rain cannot be used together" << std::endl;
+        exit(1);
+    }
+    if (opts->debugLayout && (opts->gpuRain || opts->analyticRain)) {
+        std::cerr << "--debug-layout only works with the CPU rain" << std::endl;
+        exit(1);
+    }
+    if (opts->recordPath.has_value() && opts->replayPath.has_value()) {
+        std::cerr << "--record and --replay cannot be used together" << std::endl;
+        exit(1);
+    }
+    // Text alone takes the place of the default charset
+    if (opts->charsetText.has_value() && !hasSetCharset) {
+        opts->charsets.clear();
+    }
+    if (opts->charsets.empty() && !opts->charsetText.has_value()) {
+        std::cerr << "--charset needs at least one charset" << std::endl;
+        exit(1);
+    }
     if (!hasSetApp) {
         opts->app = new char[sizeof(DEFAULT_APP)];
         strcpy(opts->app, DEFAULT_APP);
@@ -0,0 +1,142 @@
+#include "quality_governor.h"
+#include <gl_errors.h>
+#include <algorithm>
+#include <iostream>
+
+// Highest quality first, every rung gives up one thing. Android draws straight to the window,
+// so only the raindrops are left to trade there
+static constexpr qualityLevel qualityLadder[] = {
+#ifdef __ANDROID__
+    {1.0f,  4, true,  1.0f},
+    {0.75f, 4, true,  1.0f},
+    {0.5f,  4, true,  1.0f},
+    {0.35f, 4, true,  1.0f},
+#else
+    {1.0f,  4, true,  1.0f},
+    {1.0f,  2, true,  1.0f},
+    {1.0f,  2, false, 1.0f},
+    {0.75f, 1, false, 1.0f},
+    {0.75f, 1, false, 0.75f},
+    {0.5f,  1, false, 0.75f},
+    {0.5f,  1, false, 0.5f},
+#endif
+};
+static constexpr int qualityLevels = sizeof(qualityLadder) / sizeof(qualityLadder[0]);
+
+void QualityGovernor::initialize(const float budget) {
+    this->budget = budget;
+    current = 0;
+#ifndef __ANDROID__
+    GL_CHECK(glGenQueries(QUALITY_GPU_QUERIES, queries));
+#endif
+}
+
+void QualityGovernor::destroy() {
+#ifndef __ANDROID__
+    GL_CHECK(glDeleteQueries(QUALITY_GPU_QUERIES, queries));
+#endif
+}
+
+void QualityGovernor::frameBegin() {
+    frameStart = tickRateClock::now();
+#ifndef __ANDROID__
+    // Skip timing this frame rather than reuse a query whose result has not come back yet
+    if (!queryPending[nextQuery]) {
+        GL_CHECK(glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]));
+        queryActive = true;
+    }
+#endif
+}
+
+bool QualityGovernor::frameEnd() {
+#ifndef __ANDROID__
+    if (queryActive) {
+        GL_CHECK(glEndQuery(GL_TIME_ELAPSED));
+        queryPending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % QUALITY_GPU_QUERIES;
+        queryActive = false;
+    }
+    collectGpuTimes();
+#endif
+    cpuTime += chrono_impl::duration_cast<chrono_impl::duration<double>>(tickRateClock::now() - frameStart).count();
+    if (++windowFrames < QUALITY_WINDOW_FRAMES) {
+        return false;
+    }
+
+    const double cpu = cpuTime / windowFrames;
+    const double gpu = gpuFrames > 0 ? gpuTime / gpuFrames : 0.0;
+    cpuTime = gpuTime = 0.0;
+    windowFrames = gpuFrames = 0;
+
+    // The window right after a change paid for rebuilding the framebuffers
+    if (settling) {
+        settling = false;
+        return false;
+    }
+
+    // Frames are pipelined, so whichever side is slower sets the frame time
+    const double cost = std::max(cpu, gpu);
+    windowsSinceClimb++;
+    if (cost > budget * QUALITY_DOWN_THRESHOLD) {
+        upWindows = 0;
+        if (++downWindows >= QUALITY_DOWN_WINDOWS && current < qualityLevels - 1) {
+            if (windowsSinceClimb <= QUALITY_DOWN_WINDOWS) {
+                upWindowsNeeded = std::min(upWindowsNeeded * 2, QUALITY_MAX_UP_WINDOWS);
+            }
+            changeLevel(1, "over budget", cpu, gpu);
+            return true;
+        }
+    } else if (cost < budget * QUALITY_UP_THRESHOLD) {
+        downWindows = 0;
+        if (++upWindows >= upWindowsNeeded && current > 0) {
+            windowsSinceClimb = 0;
+            changeLevel(-1, "under budget", cpu, gpu);
+            return true;
+        }
+    } else {
+        downWindows = 0;
+        upWindows = 0;
+    }
+    return false;
+}
+
+const qualityLevel &QualityGovernor::level() const {
+    return qualityLadder[current];
+}
+
+const qualityLevel &QualityGovernor::ladderLevel(const int index) {
+    return qualityLadder[std::clamp(index, 0, qualityLevels - 1)];
+}
+
+void QualityGovernor::collectGpuTimes() {
+#ifndef __ANDROID__
+    for (int i = 0; i < QUALITY_GPU_QUERIES; ++i) {
+        if (!queryPending[i]) {
+            continue;
+        }
+        GLuint available = GL_FALSE;
+        GL_CHECK(glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available));
+        if (available) {
+            GLuint64 elapsed = 0;
+            GL_CHECK(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed));
+            gpuTime += static_cast<double>(elapsed) / 1e9;
+            gpuFrames++;
+            queryPending[i] = false;
+        }
+    }
+#endif
+}
+
+void QualityGovernor::changeLevel(const int direction, const char *reason, const double cpu, const double gpu) {
+    const int previous = current;
+    current += direction;
+    downWindows = 0;
+    upWindows = 0;
+    settling = true;
+
+    const qualityLevel &level = qualityLadder[current];
+    std::cout << "Quality " << previous << " -> " << current << ", " << reason
+              << " (cpu " << cpu * 1000.0 << " ms, gpu " << gpu * 1000.0 << " ms, budget " << budget * 1000.0 << " ms): "
+              << level.dropScale * 100.0f << "% drops, " << level.antialiasSamples << "x MSAA, blur "
+              << (level.blur ? "on" : "off") << ", " << level.resolutionScale * 100.0f << "% resolution" << std::endl;
+}
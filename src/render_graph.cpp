@@ -0,0 +1,348 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <climits>
+#include <gl_errors.h>
+#include <iostream>
+
+void createRenderTarget(renderTarget &target, const renderTargetDesc &desc, const long width, const long height) {
+    target.desc = desc;
+    target.width = width;
+    target.height = height;
+    GL_CHECK(glGenFramebuffers(1, &target.fbo));
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, target.fbo));
+
+    if (desc.samples > 1) {
+#ifdef __ANDROID__
+        // OpenGL ES 3.0: Use renderbuffer for multisampling instead of multisampled textures
+        GL_CHECK(glGenRenderbuffers(1, &target.texture));
+        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, target.texture));
+        GL_CHECK(glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.format, width, height));
+        GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.texture));
+#else
+        GL_CHECK(glGenTextures(1, &target.texture));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.texture));
+        GL_CHECK(glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.format, width, height, GL_TRUE));
+        GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, target.texture, 0));
+#endif
+    } else {
+        GL_CHECK(glGenTextures(1, &target.texture));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, target.texture));
+
+        // GL_RGBA8 and GL_RGBA16F are internal formats, but glTexImage2D expects GL_RGBA for the format parameter
+        const GLenum dataFormat = (desc.format == GL_RGBA8 || desc.format == GL_RGBA16F) ? GL_RGBA : desc.format;
+        const GLenum dataType = desc.format == GL_RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+
+        GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, desc.format, width, height, 0, dataFormat, dataType, nullptr));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0));
+    }
+
+    if (desc.depthStencil) {
+        GL_CHECK(glGenRenderbuffers(1, &target.depthStencil));
+        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, target.depthStencil));
+        GL_CHECK(glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples > 1 ? desc.samples : 0,
+            GL_DEPTH24_STENCIL8, width, height));
+        GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depthStencil));
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Framebuffer is not complete" << std::endl;
+        exit(1);
+    }
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+static long scaledSize(const long size, const renderTargetDesc &desc) {
+    return std::max(size >> desc.downscale, 1L);
+}
+
+void destroyRenderTarget(renderTarget &target) {
+    GL_CHECK(glDeleteFramebuffers(1, &target.fbo));
+#ifdef __ANDROID__
+    if (target.desc.samples > 1) {
+        GL_CHECK(glDeleteRenderbuffers(1, &target.texture));
+    } else {
+        GL_CHECK(glDeleteTextures(1, &target.texture));
+    }
+#else
+    GL_CHECK(glDeleteTextures(1, &target.texture));
+#endif
+    if (target.depthStencil != 0) {
+        GL_CHECK(glDeleteRenderbuffers(1, &target.depthStencil));
+    }
+    target = renderTarget{};
+}
+
+void RenderGraph::resize(const long width, const long height) {
+    destroy();
+    this->width = width;
+    this->height = height;
+}
+
+void RenderGraph::destroy() {
+    for (cachedTarget &cached : cache) {
+        destroyRenderTarget(cached.target);
+    }
+    for (historyNode &history : histories) {
+        destroyRenderTarget(history.target);
+    }
+    cache.clear();
+    histories.clear();
+    begin();
+}
+
+void RenderGraph::begin() {
+    resources.clear();
+    passes.clear();
+    retained.clear();
+    steps.clear();
+    frame++;
+
+    // Nothing holds on to cache indices between frames, so targets left over from a bigger graph can go
+    for (size_t i = cache.size(); i-- > 0;) {
+        if (frame - cache[i].lastFrame > RENDER_GRAPH_IDLE_FRAMES) {
+            destroyRenderTarget(cache[i].target);
+            cache.erase(cache.begin() + static_cast<long>(i));
+        }
+    }
+}
+
+renderResource RenderGraph::import(const char *name, const renderTarget &target) {
+    resourceNode resource;
+    resource.name = name;
+    resource.kind = IMPORTED;
+    resource.desc = target.desc;
+    resource.imported = target;
+    resources.push_back(resource);
+    return static_cast<renderResource>(resources.size() - 1);
+}
+
+renderResource RenderGraph::create(const char *name, const renderTargetDesc &desc) {
+    resourceNode resource;
+    resource.name = name;
+    resource.kind = TRANSIENT;
+    resource.desc = desc;
+    resources.push_back(resource);
+    return static_cast<renderResource>(resources.size() - 1);
+}
+
+renderResource RenderGraph::history(const char *name, const renderTargetDesc &desc) {
+    historyTarget(name, desc);
+    resourceNode resource;
+    resource.name = name;
+    resource.kind = HISTORY;
+    resource.desc = desc;
+    for (size_t i = 0; i < histories.size(); ++i) {
+        if (histories[i].name == name) {
+            resource.physical = static_cast<int>(i);
+        }
+    }
+    resources.push_back(resource);
+    return static_cast<renderResource>(resources.size() - 1);
+}
+
+void RenderGraph::addPass(const char *name, std::vector<renderResource> reads, const renderResource write,
+                          renderPassFunction execute) {
+    passes.push_back({name, std::move(reads), write, std::move(execute)});
+}
+
+void RenderGraph::retain(const renderResource history, const renderResource resource) {
+    if (resources[history].kind != HISTORY) {
+        std::cerr << "Render graph: " << resources[history].name << " is not a history" << std::endl;
+        exit(1);
+    }
+    retained.emplace_back(history, resource);
+}
+
+renderTarget &RenderGraph::historyTarget(const char *name, const renderTargetDesc &desc) {
+    for (size_t i = 0; i < histories.size(); ++i) {
+        if (histories[i].name != name) {
+            continue;
+        }
+        if (histories[i].target.desc == desc) {
+            return histories[i].target;
+        }
+        destroyRenderTarget(histories[i].target);
+        histories.erase(histories.begin() + static_cast<long>(i));
+        break;
+    }
+    histories.push_back({name, {}});
+    renderTarget &target = histories.back().target;
+    createRenderTarget(target, desc, scaledSize(width, desc), scaledSize(height, desc));
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, target.fbo));
+    GL_CHECK(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+    GL_CHECK(glClear(GL_COLOR_BUFFER_BIT));
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    return target;
+}
+
+const renderTarget *RenderGraph::findHistory(const char *name) const {
+    for (const historyNode &history : histories) {
+        if (history.name == name) {
+            return &history.target;
+        }
+    }
+    return nullptr;
+}
+
+renderResource RenderGraph::resolve(const renderResource resource, std::vector<bool> &resolvedValid) {
+    if (resources[resource].desc.samples <= 1) {
+        return resource;
+    }
+    // Passes reading the same contents share one resolve
+    if (resolvedValid[resource]) {
+        return resources[resource].resolved;
+    }
+    renderTargetDesc desc = resources[resource].desc;
+    desc.samples = 1;
+    desc.depthStencil = false;
+    const std::string name = resources[resource].name + " resolved";
+    const renderResource resolved = create(name.c_str(), desc);
+    resources[resource].resolved = resolved;
+    resolvedValid[resource] = true;
+    resolvedValid.push_back(false);
+    steps.push_back({-1, {resource}, resolved, false});
+    return resolved;
+}
+
+int RenderGraph::acquire(const renderTargetDesc &desc) {
+    for (size_t i = 0; i < cache.size(); ++i) {
+        if (!cache[i].used && cache[i].target.desc == desc) {
+            cache[i].used = true;
+            cache[i].lastFrame = frame;
+            return static_cast<int>(i);
+        }
+    }
+    cachedTarget cached{{}, true, frame};
+    createRenderTarget(cached.target, desc, scaledSize(width, desc), scaledSize(height, desc));
+    cache.push_back(cached);
+    return static_cast<int>(cache.size() - 1);
+}
+
+void RenderGraph::compile() {
+    // Order the passes with a resolve wherever a multisampled resource is read after being drawn into
+    std::vector<bool> resolvedValid(resources.size(), false);
+    for (size_t p = 0; p < passes.size(); ++p) {
+        std::vector<renderResource> reads;
+        for (const renderResource read : passes[p].reads) {
+            reads.push_back(resolve(read, resolvedValid));
+        }
+        steps.push_back({static_cast<int>(p), reads, passes[p].write, false});
+        resolvedValid[passes[p].write] = false;
+    }
+    for (auto &[history, resource] : retained) {
+        resource = resolve(resource, resolvedValid);
+    }
+
+    // Walk back from what leaves the frame, every pass clears its target so a write ends the need for it
+    std::vector<bool> needed(resources.size(), false);
+    for (const auto &[history, resource] : retained) {
+        needed[resource] = true;
+    }
+    for (size_t i = steps.size(); i-- > 0;) {
+        stepNode &step = steps[i];
+        step.live = needed[step.write] || resources[step.write].kind != TRANSIENT;
+        if (!step.live) {
+            continue;
+        }
+        needed[step.write] = false;
+        for (const renderResource read : step.reads) {
+            needed[read] = true;
+        }
+    }
+
+    // Lifetimes in steps, a retained resource lives past the frame
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (!steps[i].live) {
+            continue;
+        }
+        const int step = static_cast<int>(i);
+        resourceNode &write = resources[steps[i].write];
+        write.firstStep = write.firstStep < 0 ? step : write.firstStep;
+        write.lastStep = std::max(write.lastStep, step);
+        for (const renderResource read : steps[i].reads) {
+            resources[read].lastStep = std::max(resources[read].lastStep, step);
+        }
+    }
+    for (const auto &[history, resource] : retained) {
+        resources[resource].lastStep = INT_MAX;
+    }
+
+    // A target goes back to the cache after the last step using it, so a pass never draws into what it samples
+    for (cachedTarget &cached : cache) {
+        cached.used = false;
+    }
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (!steps[i].live) {
+            continue;
+        }
+        resourceNode &write = resources[steps[i].write];
+        if (write.kind == TRANSIENT && write.physical < 0) {
+            write.physical = acquire(write.desc);
+        }
+        std::vector<renderResource> used = steps[i].reads;
+        used.push_back(steps[i].write);
+        for (const renderResource resource : used) {
+            if (resources[resource].kind == TRANSIENT && resources[resource].lastStep == static_cast<int>(i)) {
+                cache[resources[resource].physical].used = false;
+            }
+        }
+    }
+}
+
+void RenderGraph::execute() {
+    for (const stepNode &step : steps) {
+        if (!step.live) {
+            continue;
+        }
+        const renderTarget &write = physicalTarget(step.write);
+        if (step.pass < 0) {
+            const renderTarget &source = physicalTarget(step.reads[0]);
+            GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo));
+            GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, write.fbo));
+            GL_CHECK(glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, write.width, write.height,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST));
+            continue;
+        }
+        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, write.fbo));
+        GL_CHECK(glViewport(0, 0, write.width, write.height));
+        GL_CHECK(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+        GL_CHECK(glClear(GL_COLOR_BUFFER_BIT));
+        passes[step.pass].execute(*this);
+    }
+
+    // Hand the retained targets over, the history's old target becomes free for the next frame
+    for (const auto &[history, resource] : retained) {
+        renderTarget &kept = histories[resources[history].physical].target;
+        if (resources[resource].kind == TRANSIENT && resources[resource].desc == kept.desc) {
+            std::swap(kept, cache[resources[resource].physical].target);
+            continue;
+        }
+        const renderTarget &source = physicalTarget(resource);
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo));
+        GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, kept.fbo));
+        GL_CHECK(glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, kept.width, kept.height,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR));
+    }
+}
+
+const renderTarget &RenderGraph::physicalTarget(const renderResource resource) const {
+    const resourceNode &node = resources[resource];
+    switch (node.kind) {
+        case IMPORTED:
+            return node.imported;
+        case HISTORY:
+            return histories[node.physical].target;
+        default:
+            return cache[node.physical].target;
+    }
+}
+
+const renderTarget &RenderGraph::target(const renderResource resource) const {
+    const renderResource resolved = resources[resource].resolved;
+    return physicalTarget(resolved >= 0 ? resolved : resource);
+}
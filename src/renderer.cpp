@@ -9,8 +9,8 @@
 #include <vector>
 #include "basic_texture_fragment_shader.h"
 #include "basic_texture_vertex_shader.h"
-#include "ghosting_fragment_shader.h"
-#include "blur_fragment_shader.h"
+#include "post_processing_fragment_shader.h"
+#include "fade_fragment_shader.h"
 
 #if defined(__linux__) && !defined(__ANDROID__)
 #include "x11.h"
@@ -28,6 +28,12 @@ auto glXCreateContextAttribsARB = reinterpret_cast<glXCreateContextAttribsARBPro
 
 renderer *renderer::instance = nullptr;
 
+// What the post-processing passes sample and the ghosting history is kept in
+static constexpr renderTargetDesc postProcessingTarget = {1, GL_RGBA8, false};
+// The bloom pyramid keeps what is brighter than white
+static constexpr renderTargetDesc bloomTarget = {1, GL_RGBA16F, false};
+static constexpr const char *ghostingHistory = "ghosting";
+
 renderer::renderer(options *opts) {
     this->opts = opts;
     clock = new tickRateClock();
@@ -186,28 +192,14 @@ void renderer::makeContext() {
 }
 
 void renderer::makeFrameBuffers() {
+    renderWidth = std::max(1L, std::lround(static_cast<float>(opts->width) * quality.resolutionScale));
+    renderHeight = std::max(1L, std::lround(static_cast<float>(opts->height) * quality.resolutionScale));
 #ifdef __ANDROID__
     // On Android, we cannot create framebuffers due to hwuiTask conflicts
     // Instead, render directly to screen (FBO 0) and implement ghosting differently:
     // - Don't clear the screen completely each frame
     // - Use glBlendFunc to create trailing effect
-
-    fboC = 0;
-    fboM = 0;
-    fboP = 0;
-    fboCOutput = 0;
-    fboMOutput = 0;
-    fboPOutput = 0;
-
-    fboCTexture = 0;
-    fboMTexture = 0;
-    fboPTexture = 0;
-    fboCTextureOutput = 0;
-    fboMTextureOutput = 0;
-    fboPTextureOutput = 0;
-
-    RBO = 0;
-
+    scene = renderTarget{};
     return;
 #else
     // Desktop uses multisampling
@@ -219,87 +211,47 @@ void renderer::makeFrameBuffers() {
         antialiasSamples = maxSamples;
     }
 
-    createFrameBufferTexture(fboC, fboCTexture, GL_RGBA8, true);
-    createFrameBufferTexture(fboM, fboMTexture, GL_RGBA8, true);
-    createFrameBufferTexture(fboP, fboPTexture, GL_RGBA8, true);
-
-    createFrameBufferTexture(fboCOutput, fboCTextureOutput, GL_RGBA8, false);
-    createFrameBufferTexture(fboMOutput, fboMTextureOutput, GL_RGBA8, false);
-    createFrameBufferTexture(fboPOutput, fboPTextureOutput, GL_RGBA8, false);
-
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-
-    // Create renderbuffer for depth/stencil
-    GL_CHECK(glGenRenderbuffers(1, &RBO));
-    GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, RBO));
-    GL_CHECK(
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, antialiasSamples, GL_DEPTH24_STENCIL8, opts->width, opts->
-            height));
-
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fboC));
-    GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO));
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer is not complete" << std::endl;
-        exit(1);
-    }
-
-    // Unbind the framebuffer
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    // Only the scene is multisampled, the graph makes the rest once a pass needs them
+    // Half floats let the app draw brighter than white for the bloom, only when the app uses it
+    const GLenum sceneFormat = opts->postProcessingOptions & BLOOM ? GL_RGBA16F : GL_RGBA8;
+    createRenderTarget(scene, {antialiasSamples, sceneFormat, false}, renderWidth, renderHeight);
+    graph.resize(renderWidth, renderHeight);
 #endif
 }
 
-void renderer::createFrameBufferTexture(GLuint &fbo, GLuint &fboTexture, const GLuint format,
-                                        const bool multiSampled) const {
-#ifdef __ANDROID__
-    GL_CHECK(glGenFramebuffers(1, &fbo));
-#else
-    GL_CHECK(glCreateFramebuffers(1, &fbo));
-#endif
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
-
-    if (multiSampled) {
-#ifdef __ANDROID__
-        // OpenGL ES 3.0: Use renderbuffer for multisampling instead of multisampled textures
-        GL_CHECK(glGenRenderbuffers(1, &fboTexture));
-        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, fboTexture));
-        GL_CHECK(glRenderbufferStorageMultisample(GL_RENDERBUFFER, antialiasSamples, format, opts->width, opts->height));
-        GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, fboTexture));
-
-        // Verify framebuffer is complete
-        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-            // Framebuffer incomplete - silently fail on Android
-        }
-#else
-        // Desktop OpenGL: Use multisampled textures
-        GL_CHECK(glGenTextures(1, &fboTexture));
-        GL_CHECK(glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, fboTexture));
-        GL_CHECK(
-            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, antialiasSamples, format, opts->width, opts->height,
-                GL_TRUE));
-        GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, fboTexture, 0));
+void renderer::destroyFrameBuffers() {
+    if (scene.fbo != 0) {
+        destroyRenderTarget(scene);
+    }
+#ifndef __ANDROID__
+    if (checkpointResolve.fbo != 0) {
+        destroyRenderTarget(checkpointResolve);
+    }
 #endif
-    } else {
-        GL_CHECK(glGenTextures(1, &fboTexture));
-        GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboTexture));
-
-        // Determine the format for the texture data (not internal format)
-        // GL_RGBA8 is an internal format, but glTexImage2D expects GL_RGBA for the format parameter
-        GLuint dataFormat = (format == GL_RGBA8) ? GL_RGBA : format;
+    graph.destroy();
+}
 
-        GL_CHECK(
-            glTexImage2D(GL_TEXTURE_2D, 0, format, opts->width, opts->height, 0, dataFormat, GL_UNSIGNED_BYTE, nullptr));
-        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-        GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture, 0));
+static std::string postProcessingDefines(const uint8_t stages) {
+    std::string defines;
+    if (stages & GHOSTING) {
+        defines += "#define POST_GHOSTING\n";
     }
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer is not complete" << std::endl;
-        exit(1);
+    if (stages & BLUR) {
+        defines += "#define POST_BLUR\n";
     }
+    if (stages & BLOOM) {
+        defines += "#define POST_BLOOM\n";
+    }
+    return defines;
+}
+
+static ShaderProgram *postProcessingProgram(const std::string &defines) {
+    auto *program = new ShaderProgram();
+    program->loadShader(basicTextureVertexShader, sizeof(basicTextureVertexShader), GL_VERTEX_SHADER);
+    program->loadShader(postProcessingFragmentShader, sizeof(postProcessingFragmentShader), GL_FRAGMENT_SHADER,
+        defines);
+    program->linkProgram();
+    return program;
 }
 
 void renderer::initializePP() {
@@ -315,29 +267,11 @@ void renderer::initializePP() {
     GL_CHECK(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), nullptr));
     GL_CHECK(glEnableVertexAttribArray(0));
 
-    // Create a simple shader program for drawing solid color quad
-    const char* fadeVertexShader = R"(
-        #version 300 es
-        layout(location = 0) in vec2 position;
-        void main() {
-            gl_Position = vec4(position, 0.0, 1.0);
-        }
-    )";
-
-    const char* fadeFragmentShader = R"(
-        #version 300 es
-        precision mediump float;
-        uniform float u_alpha;
-        out vec4 fragColor;
-        void main() {
-            fragColor = vec4(0.0, 0.0, 0.0, u_alpha);
-        }
-    )";
-
-    ppFinalProgram = new ShaderProgram();
-    ppFinalProgram->loadShader(fadeVertexShader, GL_VERTEX_SHADER);
-    ppFinalProgram->loadShader(fadeFragmentShader, GL_FRAGMENT_SHADER);
-    ppFinalProgram->linkProgram();
+    // The fade quad for ghosting on the window
+    ppFadeProgram = new ShaderProgram();
+    ppFadeProgram->loadShader(basicTextureVertexShader, sizeof(basicTextureVertexShader), GL_VERTEX_SHADER);
+    ppFadeProgram->loadShader(fadeFragmentShader, sizeof(fadeFragmentShader), GL_FRAGMENT_SHADER);
+    ppFadeProgram->linkProgram();
 
     return;
 #endif
@@ -363,18 +297,35 @@ void renderer::initializePP() {
     ppFinalProgram->loadShader(basicTextureFragmentShader, sizeof(basicTextureFragmentShader), GL_FRAGMENT_SHADER);
     ppFinalProgram->linkProgram();
 
-    // Create option specific post-processing programs
-    if (opts->postProcessingOptions & GHOSTING) {
-        ppGhostingProgram = new ShaderProgram();
-        ppGhostingProgram->loadShader(basicTextureVertexShader, sizeof(basicTextureVertexShader), GL_VERTEX_SHADER);
-        ppGhostingProgram->loadShader(ghostingFragmentShader, sizeof(ghostingFragmentShader), GL_FRAGMENT_SHADER);
-        ppGhostingProgram->linkProgram();
+    // Create a program for every combination of stages a pass can fuse, the ghosting history is blurred on its own
+    uint8_t stages = opts->postProcessingOptions & (BLUR | BLOOM);
+    if (opts->postProcessingOptions & GHOSTING && !opts->accumulateGhosting) {
+        stages |= GHOSTING | BLUR;
+    }
+    for (uint8_t variant = 0; variant <= (GHOSTING | BLUR | BLOOM); ++variant) {
+        if ((variant & ~stages) == 0) {
+            ppPrograms[variant] = postProcessingProgram(postProcessingDefines(variant));
+        }
     }
-    if (opts->postProcessingOptions & (GHOSTING | BLUR)) {
-        ppBlurProgram = new ShaderProgram();
-        ppBlurProgram->loadShader(basicTextureVertexShader, sizeof(basicTextureVertexShader), GL_VERTEX_SHADER);
-        ppBlurProgram->loadShader(blurFragmentShader, sizeof(blurFragmentShader), GL_FRAGMENT_SHADER);
-        ppBlurProgram->linkProgram();
+    // And the pyramid passes
+    if (stages & (BLUR | BLOOM)) {
+        ppDownsamplePrograms[0] = postProcessingProgram("#define POST_DOWNSAMPLE\n");
+        ppUpsamplePrograms[0] = postProcessingProgram("#define POST_UPSAMPLE\n");
+    }
+    if (stages & GHOSTING && stages & BLUR) {
+        ppDownsamplePrograms[GHOSTING] =
+            postProcessingProgram(postProcessingDefines(GHOSTING) + "#define POST_DOWNSAMPLE\n");
+    }
+    if (stages & BLOOM) {
+        ppUpsamplePrograms[BLOOM] = postProcessingProgram(postProcessingDefines(BLOOM) + "#define POST_UPSAMPLE\n");
+        ppBrightPassProgram = postProcessingProgram("#define POST_BRIGHT_PASS\n#define POST_DOWNSAMPLE\n");
+        bloomTimer.initialize("Bloom");
+    }
+    if (opts->postProcessingOptions & GHOSTING && opts->accumulateGhosting) {
+        ppFadeProgram = new ShaderProgram();
+        ppFadeProgram->loadShader(basicTextureVertexShader, sizeof(basicTextureVertexShader), GL_VERTEX_SHADER);
+        ppFadeProgram->loadShader(fadeFragmentShader, sizeof(fadeFragmentShader), GL_FRAGMENT_SHADER);
+        ppFadeProgram->linkProgram();
     }
 
     GL_CHECK(glEnable(GL_BLEND));
@@ -385,12 +336,80 @@ void renderer::initialize() {
 #if defined(__linux__) && !defined(__ANDROID__)
     setupSignalHandling();
 #endif
+    // The distance field antialiases the glyphs, multisampling would only cost fill rate
+    if (opts->distanceFieldGlyphs) {
+        antialiasSamples = 0;
+    }
     makeContext();
-    makeFrameBuffers();
     clock->initialize();
+    if (opts->checkpointPath.has_value()) {
+        checkpointWriter = new CheckpointWriter();
+        checkpoint = new CheckpointReader();
+        if (!checkpoint->open(opts->checkpointPath.value())) {
+            delete checkpoint;
+            checkpoint = nullptr;
+        }
+    }
+    // Opened before the app so it can hand over the recorded seed
+    if (opts->replayPath.has_value()) {
+        replayer = new EventReplayer();
+        replayer->open(opts->replayPath.value(), *opts);
+    }
     loadApp();
     opts->maskPostProcessingOptionsWithUserAllowed();
+    // The scene format depends on the stages the app turned on
+    makeFrameBuffers();
     initializePP();
+#ifndef __ANDROID__
+    // The ghosting history of the first frame is drawn in the scene and resolved into it
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo));
+    GL_CHECK(glViewport(0, 0, renderWidth, renderHeight));
+    clear();
+#endif
+    if (checkpoint != nullptr) {
+        restoreCheckpoint();
+        delete checkpoint;
+        checkpoint = nullptr;
+    }
+#ifndef __ANDROID__
+    // The first frame fades in whatever the app fast-forwarded, instead of an empty history. Accumulated
+    // ghosting keeps fading the scene, so it already is the history
+    if (opts->postProcessingOptions & GHOSTING) {
+        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo));
+        app->warmUp();
+    }
+    if (opts->postProcessingOptions & GHOSTING && !opts->accumulateGhosting) {
+        const renderTarget &history = graph.historyTarget(ghostingHistory, postProcessingTarget);
+        // A multisampled blit can't change the format, a half float scene is resolved before it is converted
+        renderTarget resolved{};
+        GLuint source = scene.fbo;
+        if (scene.desc.format != history.desc.format) {
+            createRenderTarget(resolved, {1, scene.desc.format, false}, renderWidth, renderHeight);
+            GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, scene.fbo));
+            GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolved.fbo));
+            GL_CHECK(glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST));
+            source = resolved.fbo;
+        }
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, source));
+        GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, history.fbo));
+        GL_CHECK(glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST));
+        if (resolved.fbo != 0) {
+            destroyRenderTarget(resolved);
+        }
+    }
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+#endif
+    if (opts->recordPath.has_value()) {
+        recorder = new EventRecorder();
+        recorder->open(opts->recordPath.value(), *opts);
+    }
+    // A replay takes its quality levels from the log
+    if (opts->qualityGovernor && replayer == nullptr) {
+        governor = new QualityGovernor();
+        governor->initialize(opts->swapTime);
+    }
 }
 
 void renderer::swapBuffers() {
@@ -411,7 +430,23 @@ void renderer::swapBuffers() {
 #endif
 }
 
-void renderer::destroy() const {
+void renderer::destroy() {
+    // The last frame is checkpointed while the app and the framebuffers still exist
+    if (checkpointWriter != nullptr) {
+        if (app != nullptr) {
+            saveCheckpoint();
+        }
+        delete checkpointWriter;
+        if (checkpointFence != nullptr) {
+            GL_CHECK(glDeleteSync(checkpointFence));
+        }
+#ifndef __ANDROID__
+        if (checkpointPixelBuffer != 0) {
+            GL_CHECK(glDeleteBuffers(1, &checkpointPixelBuffer));
+        }
+#endif
+    }
+
     // Destroy app first if it exists (while context is still valid)
     if (app != nullptr) {
         try {
@@ -424,32 +459,43 @@ void renderer::destroy() const {
     // CRITICAL: Delete OpenGL resources BEFORE destroying the EGL context
     // Delete the framebuffers
     try {
-        GL_CHECK(glDeleteFramebuffers(1, &fboC));
-        GL_CHECK(glDeleteTextures(1, &fboCTexture));
-        GL_CHECK(glDeleteFramebuffers(1, &fboM));
-        GL_CHECK(glDeleteTextures(1, &fboMTexture));
-        GL_CHECK(glDeleteFramebuffers(1, &fboP));
-        GL_CHECK(glDeleteTextures(1, &fboPTexture));
-
-        GL_CHECK(glDeleteFramebuffers(1, &fboCOutput));
-        GL_CHECK(glDeleteTextures(1, &fboCTextureOutput));
-        GL_CHECK(glDeleteFramebuffers(1, &fboMOutput));
-        GL_CHECK(glDeleteTextures(1, &fboMTextureOutput));
-        GL_CHECK(glDeleteFramebuffers(1, &fboPOutput));
-        GL_CHECK(glDeleteTextures(1, &fboPTextureOutput));
-
-        GL_CHECK(glDeleteRenderbuffers(1, &RBO));
+        if (governor != nullptr) {
+            governor->destroy();
+            delete governor;
+        }
+        if (recorder != nullptr) {
+            recorder->close();
+            delete recorder;
+        }
+        delete replayer;
+        destroyFrameBuffers();
         GL_CHECK(glDeleteVertexArrays(1, &ppFullQuadArray));
         GL_CHECK(glDeleteBuffers(1, &ppFullQuadBuffer));
 
         if (ppFinalProgram != nullptr) {
             ppFinalProgram->destroy();
         }
-        if (opts->postProcessingOptions & GHOSTING && ppGhostingProgram != nullptr) {
-            ppGhostingProgram->destroy();
+        if (ppFadeProgram != nullptr) {
+            ppFadeProgram->destroy();
+        }
+        for (const ShaderProgram *program : ppPrograms) {
+            if (program != nullptr) {
+                program->destroy();
+            }
         }
-        if (opts->postProcessingOptions & BLUR && ppBlurProgram != nullptr) {
-            ppBlurProgram->destroy();
+        for (const ShaderProgram *program : ppDownsamplePrograms) {
+            if (program != nullptr) {
+                program->destroy();
+            }
+        }
+        for (const ShaderProgram *program : ppUpsamplePrograms) {
+            if (program != nullptr) {
+                program->destroy();
+            }
+        }
+        if (ppBrightPassProgram != nullptr) {
+            ppBrightPassProgram->destroy();
+            bloomTimer.destroy();
         }
     } catch (...) {
         // Catch any exceptions during OpenGL cleanup
@@ -481,6 +527,16 @@ void renderer::destroy() const {
 
 void renderer::getEvents() const {
     clock->calculateFrameSwapDeltaTime();
+    if (replayer != nullptr) {
+        // Every loop renders the next recorded frame, the log ending quits like a closed window
+        if (!replayer->next()) {
+            events->quit = true;
+            return;
+        }
+        replayer->apply(events);
+        clock->frameSwapDeltaTime = replayer->frame().swapped ? opts->swapTime : 0.0f;
+        return;
+    }
 #if defined(__linux__) && !defined(__ANDROID__)
     if (x11) {
         handleX11Events(this);
@@ -512,12 +568,22 @@ void renderer::destroyApp() const {
 }
 
 void renderer::frameBegin() const {
-    clock->calculateDeltaTime();
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fboC));
+    if (replayer != nullptr) {
+        clock->advance(replayer->frame().deltaTime);
+    } else {
+        clock->calculateDeltaTime();
+    }
+    if (governor != nullptr) {
+        governor->frameBegin();
+    }
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo));
+#ifndef __ANDROID__
+    GL_CHECK(glViewport(0, 0, renderWidth, renderHeight));
+#endif
 
+    // Accumulated ghosting darkens what is already in the framebuffer instead of clearing it, the app draws over it
+    if (opts->postProcessingOptions & GHOSTING && opts->accumulateGhosting) {
 #ifdef __ANDROID__
-    // Implement ghosting on Android using fade overlay
-    if (opts->postProcessingOptions & GHOSTING) {
         static bool firstFrame = true;
 
         // Only clear the very first frame
@@ -526,31 +592,42 @@ void renderer::frameBegin() const {
             firstFrame = false;
             return;
         }
+#endif
+        fadeFrame();
+        return;
+    }
 
-        // Draw a fade overlay to darken the previous frame
-        // More aggressive fade for more visible trails
-        float fadeAlpha = 0.08f; // 8% fade per frame = 92% retention
-
-        GL_CHECK(glDisable(GL_DEPTH_TEST));
-        GL_CHECK(glDisable(GL_CULL_FACE));
-        GL_CHECK(glEnable(GL_BLEND));
-        GL_CHECK(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-
-        ppFinalProgram->useProgram();
-        GL_CHECK(glUniform1f(ppFinalProgram->getUniformLocation("u_alpha"), fadeAlpha));
-        GL_CHECK(glBindVertexArray(ppFullQuadArray));
-        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    clear();
+}
 
+void renderer::fadeFrame() const {
+    // Calculate framerate-independent opacity, ghostingPreviousFrameOpacity is what is kept of a frame at 60 FPS
+    const float frameOpacity = pow(opts->ghostingPreviousFrameOpacity, clock->deltaTime * 60.0f);
 
-        // CRITICAL: Restore the blend mode that matrix app expects
-        // This prevents flicker by ensuring consistent blending
-        GL_CHECK(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    GL_CHECK(glDisable(GL_DEPTH_TEST));
+    GL_CHECK(glDisable(GL_CULL_FACE));
+    GL_CHECK(glEnable(GL_BLEND));
+    ppFadeProgram->useProgram();
+    GL_CHECK(glBindVertexArray(ppFullQuadArray));
 
-        return;
-    }
+#ifdef __ANDROID__
+    // The window stays opaque, only the color is scaled
+    GL_CHECK(glBlendColor(0.0f, 0.0f, 0.0f, frameOpacity));
+    GL_CHECK(glBlendFuncSeparate(GL_ZERO, GL_CONSTANT_ALPHA, GL_ZERO, GL_ONE));
+    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+#else
+    // Same falloff as blending the ghosting history over a cleared frame, where the premultiplied color is
+    // scaled by the faded alpha a second time: color *= alpha * opacity^2 and alpha *= opacity
+    GL_CHECK(glBlendFuncSeparate(GL_ZERO, GL_DST_ALPHA, GL_ZERO, GL_ONE));
+    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    const float colorOpacity = frameOpacity * frameOpacity;
+    GL_CHECK(glBlendColor(colorOpacity, colorOpacity, colorOpacity, frameOpacity));
+    GL_CHECK(glBlendFunc(GL_ZERO, GL_CONSTANT_COLOR));
+    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
 #endif
 
-    clear();
+    // Restore the blend mode the apps expect
+    GL_CHECK(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 }
 
 void renderer::clear() {
@@ -562,176 +639,404 @@ void renderer::clear() {
     GL_CHECK(glClear(GL_COLOR_BUFFER_BIT));
 }
 
-void renderer::_swapPPBuffersCM() {
-    GLuint temp = fboCTexture;
-    fboCTexture = fboMTexture;
-    fboMTexture = temp;
+renderPassFunction renderer::postProcessingPass(const ShaderProgram *program, const uint8_t stages,
+                                                const renderResource current, const renderResource history,
+                                                const renderResource bloom, const GLfloat blurSize,
+                                                const GLfloat bloomStrength) {
+    return [this, program, stages, current, history, bloom, blurSize, bloomStrength](const RenderGraph &graph) {
+        program->useProgram();
 
-    temp = fboC;
-    fboC = fboM;
-    fboM = temp;
+        GL_CHECK(glUniform1i(program->getUniformLocation("u_textureC"), 0));
+        GL_CHECK(glUniform1i(program->getUniformLocation("u_textureP"), 1));
+        GL_CHECK(glUniform1f(program->getUniformLocation("u_blurSize"), blurSize));
+        GL_CHECK(glBindVertexArray(ppFullQuadArray));
 
-    temp = fboCTextureOutput;
-    fboCTextureOutput = fboMTextureOutput;
-    fboMTextureOutput = temp;
+        GL_CHECK(glActiveTexture(GL_TEXTURE0));
+        GL_CHECK(glBindTexture(GL_TEXTURE_2D, graph.texture(current)));
 
-    temp = fboCOutput;
-    fboCOutput = fboMOutput;
-    fboMOutput = temp;
-}
+        if (stages & GHOSTING) {
+            // Calculate framerate-independent opacity
+            // ghostingPreviousFrameOpacity is the base opacity at 60 FPS (e.g., 0.97 = 97% retention per frame)
+            // Scale it based on actual frame time to maintain consistent visual decay rate
+            float targetFPS = 60.0f;
+            float frameTimeRatio = (clock->deltaTime * targetFPS);
+            // Use power function to maintain exponential decay rate across different framerates
+            float frameOpacity = pow(opts->ghostingPreviousFrameOpacity, frameTimeRatio);
 
-void renderer::_swapPPBuffersPM() {
-    GLuint temp = fboPTexture;
-    fboPTexture = fboMTexture;
-    fboMTexture = temp;
+            GL_CHECK(glUniform1f(program->getUniformLocation("u_previousFrameOpacity"), frameOpacity));
 
-    temp = fboP;
-    fboP = fboM;
-    fboM = temp;
+            GL_CHECK(glActiveTexture(GL_TEXTURE1));
+            GL_CHECK(glBindTexture(GL_TEXTURE_2D, graph.texture(history)));
+            GL_CHECK(glActiveTexture(GL_TEXTURE0));
+        }
 
-    temp = fboPTextureOutput;
-    fboPTextureOutput = fboMTextureOutput;
-    fboMTextureOutput = temp;
+        if (stages & BLOOM) {
+            GL_CHECK(glUniform1i(program->getUniformLocation("u_textureBloom"), 2));
+            GL_CHECK(glUniform1f(program->getUniformLocation("u_bloomStrength"), bloomStrength));
+            GL_CHECK(glActiveTexture(GL_TEXTURE2));
+            GL_CHECK(glBindTexture(GL_TEXTURE_2D, graph.texture(bloom)));
+            GL_CHECK(glActiveTexture(GL_TEXTURE0));
+        }
 
-    temp = fboPOutput;
-    fboPOutput = fboMOutput;
-    fboMOutput = temp;
+        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    };
 }
 
-void renderer::_resolveMultisampledFramebuffer(const GLuint srcFbo, const GLuint dstFbo) const {
-#ifdef __ANDROID__
-    // On Android without multisampling, only blit if different
-    if (srcFbo != dstFbo) {
-        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFbo));
-        GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFbo));
-        GL_CHECK(
-            glBlitFramebuffer(0, 0, opts->width, opts->height, 0, 0, opts->width, opts->height, GL_COLOR_BUFFER_BIT,
-                GL_NEAREST));
+void renderer::addPostProcessingPass(const char *name, const ShaderProgram *program, const uint8_t stages,
+                                     const renderResource current, const renderResource history,
+                                     const renderResource bloom, const renderResource write, const GLfloat blurSize,
+                                     const GLfloat bloomStrength) {
+    std::vector<renderResource> reads = {current};
+    if (stages & GHOSTING) {
+        reads.push_back(history);
+    }
+    if (stages & BLOOM) {
+        reads.push_back(bloom);
+    }
+    graph.addPass(name, reads, write,
+        postProcessingPass(program, stages, current, history, bloom, blurSize, bloomStrength));
+}
+
+void renderer::addPostProcessingPasses(const char *name, const uint8_t stages, const renderResource current,
+                                       const renderResource history, const renderResource bloom,
+                                       const renderResource write, const GLfloat blurSize) {
+    int levels = 0;
+    while (stages & BLUR && levels < BLUR_PYRAMID_MAX_LEVELS && blurSize >= BLUR_PYRAMID_MIN_SIZE * (1 << levels)) {
+        ++levels;
+    }
+    if (levels == 0) {
+        addPostProcessingPass(name, ppPrograms[stages], stages, current, history, bloom, write, blurSize,
+            BLOOM_STRENGTH / BLOOM_LEVELS);
+        return;
+    }
+
+    // Every level halves the size and doubles the reach, so the taps stay between one and two texels apart.
+    // The levels are transient, a level going up takes over the target the same level had going down
+    const GLfloat offset = blurSize / static_cast<GLfloat>(1 << levels);
+    const std::string prefix = name;
+    renderTargetDesc levelTarget = postProcessingTarget;
+    renderResource level = current;
+    for (int i = 1; i <= levels; ++i) {
+        levelTarget.downscale = i;
+        const std::string levelName = prefix + " down " + std::to_string(i);
+        const renderResource down = graph.create(levelName.c_str(), levelTarget);
+        // The ghosting stage is fused into the first downsample
+        const uint8_t fused = i == 1 ? stages & GHOSTING : 0;
+        addPostProcessingPass(levelName.c_str(), ppDownsamplePrograms[fused], fused, level, history, -1, down,
+            offset, 0.0f);
+        level = down;
+    }
+    for (int i = levels - 1; i >= 0; --i) {
+        levelTarget.downscale = i;
+        const std::string levelName = prefix + " up " + std::to_string(i);
+        const renderResource up = i == 0 ? write : graph.create(levelName.c_str(), levelTarget);
+        // The bloom is added in the last upsample
+        const uint8_t fused = i == 0 ? stages & BLOOM : 0;
+        addPostProcessingPass(levelName.c_str(), ppUpsamplePrograms[fused], fused, level, -1, bloom, up, offset,
+            BLOOM_STRENGTH / BLOOM_LEVELS);
+        level = up;
     }
-#else
-    // Desktop with multisampling - always blit to resolve
-    GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFbo));
-    GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFbo));
-    GL_CHECK(
-        glBlitFramebuffer(0, 0, opts->width, opts->height, 0, 0, opts->width, opts->height, GL_COLOR_BUFFER_BIT,
-            GL_NEAREST));
-#endif
 }
 
-void renderer::_sampleFrameBuffersForPostProcessing() const {
-    _resolveMultisampledFramebuffer(fboC, fboCOutput);
-    _resolveMultisampledFramebuffer(fboP, fboPOutput);
+renderResource renderer::addBloomPasses(const renderResource frame) {
+    // The first downsample keeps only what is brighter than white, the timer covers the whole pyramid
+    renderTargetDesc levelTarget = bloomTarget;
+    levelTarget.downscale = 1;
+    std::vector<renderResource> downs = {-1, graph.create("bloom down 1", levelTarget)};
+    const renderPassFunction brightPass = postProcessingPass(ppBrightPassProgram, 0, frame, -1, -1, 1.0f, 0.0f);
+    graph.addPass("bloom down 1", {frame}, downs[1], [this, brightPass](const RenderGraph &graph) {
+        bloomTimer.begin();
+        brightPass(graph);
+    });
+    for (int i = 2; i <= BLOOM_LEVELS; ++i) {
+        levelTarget.downscale = i;
+        const std::string levelName = "bloom down " + std::to_string(i);
+        downs.push_back(graph.create(levelName.c_str(), levelTarget));
+        addPostProcessingPass(levelName.c_str(), ppDownsamplePrograms[0], 0, downs[i - 1], -1, -1, downs[i], 1.0f,
+            0.0f);
+    }
+    // Every level going up adds the same level going down, so the glow has a tight core as well as a wide halo.
+    // It only goes back up to half size, the present pass samples it with bilinear filtering and averages the levels
+    renderResource level = downs[BLOOM_LEVELS];
+    for (int i = BLOOM_LEVELS - 1; i >= 1; --i) {
+        levelTarget.downscale = i;
+        const std::string levelName = "bloom up " + std::to_string(i);
+        const renderResource up = graph.create(levelName.c_str(), levelTarget);
+        const renderPassFunction upsample =
+            postProcessingPass(ppUpsamplePrograms[BLOOM], BLOOM, level, -1, downs[i], 1.0f, 1.0f);
+        graph.addPass(levelName.c_str(), {level, downs[i]}, up, [this, upsample, i](const RenderGraph &graph) {
+            upsample(graph);
+            if (i == 1) {
+                bloomTimer.end();
+            }
+        });
+        level = up;
+    }
+    return level;
 }
 
 void renderer::frameEnd() {
 #ifdef __ANDROID__
     // On Android, ghosting is handled in frameBegin by fading with glClear opacity
     // No FBO-based post-processing needed here
+    if (checkpointWriter != nullptr) {
+        finishCheckpoint(false);
+        if (clock->elapsedTime - lastCheckpointTime >= CHECKPOINT_INTERVAL) {
+            startCheckpoint();
+            lastCheckpointTime = clock->elapsedTime;
+        }
+    }
+    governFrame();
     return;
 #endif
 
-    // Desktop: Full post-processing with framebuffers
-    // Handle post-processing
-    if (opts->postProcessingOptions & GHOSTING) {
-        _sampleFrameBuffersForPostProcessing();
-
-        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fboM));
-        clear();  // Clear destination framebuffer before rendering ghosting blend into it
-        ppGhostingProgram->useProgram();
-
-        GL_CHECK(glUniform1i(ppGhostingProgram->getUniformLocation("u_textureC"), 0));
-        GL_CHECK(glUniform1i(ppGhostingProgram->getUniformLocation("u_textureP"), 1));
-#ifdef __ANDROID__
-        GL_CHECK(
-            glUniform1f(ppGhostingProgram->getUniformLocation("u_previousFrameOpacity"), opts->
-                ghostingPreviousFrameOpacity));
-#else
-        // Calculate framerate-independent opacity
-        // ghostingPreviousFrameOpacity is the base opacity at 60 FPS (e.g., 0.97 = 97% retention per frame)
-        // Scale it based on actual frame time to maintain consistent visual decay rate
-        float targetFPS = 60.0f;
-        float frameTimeRatio = (clock->deltaTime * targetFPS);
-        // Use power function to maintain exponential decay rate across different framerates
-        float frameOpacity = pow(opts->ghostingPreviousFrameOpacity, frameTimeRatio);
-
-        GL_CHECK(glUniform1f(ppGhostingProgram->getUniformLocation("u_previousFrameOpacity"), frameOpacity));
-#endif
-        GL_CHECK(glBindVertexArray(ppFullQuadArray));
-
-        // Bind the framebuffer textures
-        GL_CHECK(glActiveTexture(GL_TEXTURE0));
-        GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboCTextureOutput));
-
-        GL_CHECK(glActiveTexture(GL_TEXTURE1));
-        GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboPTextureOutput));
-
-        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    // Desktop: the post-processing passes for this frame's options, the graph works out the targets
+    const bool swap = clock->frameSwapDeltaTime >= opts->swapTime;
+    graph.begin();
+    const renderResource frame = app->addRenderPasses(graph, graph.import("scene", scene));
+    renderTarget windowTarget{};
+    windowTarget.width = opts->width;
+    windowTarget.height = opts->height;
+    const renderResource window = graph.import("window", windowTarget);
+
+    // Accumulated ghosting already faded the scene in frameBegin
+    uint8_t stages = opts->accumulateGhosting ? 0 : opts->postProcessingOptions & GHOSTING;
+    if (opts->postProcessingOptions & BLUR && quality.blur) {
+        stages |= BLUR;
+    }
+    renderResource bloom = -1;
+    if (opts->postProcessingOptions & BLOOM && quality.blur) {
+        bloom = addBloomPasses(frame);
+        stages |= BLOOM;
+    }
+    renderResource history = -1;
+    if (stages & GHOSTING) {
+        history = graph.history(ghostingHistory, postProcessingTarget);
+        // A swap replaces the history with the presented frame, in between it only gets softer
+        if (opts->ghostingBlurSize > 0.0f && quality.blur && !swap) {
+            const renderResource blurred = graph.create("ghosting blur", postProcessingTarget);
+            addPostProcessingPasses("ghosting blur", BLUR, history, -1, -1, blurred, opts->ghostingBlurSize);
+            graph.retain(history, blurred);
+        }
+    }
 
-        _swapPPBuffersCM();
-        if (opts->ghostingBlurSize > 0.0f) {
-            GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fboM));
-            ppBlurProgram->useProgram();
+    // All stages fuse into one pass, the ghosting is evaluated at every tap of the blur, or of the first downsample
+    // of a blur pyramid. It draws straight to the window, unless the frame is kept as the ghosting history or the
+    // governor lowered the resolution, then the stages run at the render resolution and the window only gets the
+    // scaled copy. The bloom is only ever added on the way to the window, so it never builds up in the history
+    const bool keep = history >= 0 && swap;
+    const bool scaled = renderWidth != opts->width || renderHeight != opts->height;
+    renderResource presented = frame;
+    if ((stages & ~BLOOM) != 0 && (keep || scaled)) {
+        presented = graph.create("post-processing", postProcessingTarget);
+        addPostProcessingPasses("post-processing", stages & ~BLOOM, frame, history, -1, presented, opts->blurSize);
+        stages &= BLOOM;
+    }
+    addPostProcessingPasses("present", stages, presented, history, bloom, window, opts->blurSize);
+    if (keep) {
+        graph.retain(history, presented);
+    }
 
-            GL_CHECK(glUniform1i(ppBlurProgram->getUniformLocation("u_textureC"), 0));
-            GL_CHECK(glUniform1f(ppBlurProgram->getUniformLocation("u_blurSize"), opts->ghostingBlurSize));
-            GL_CHECK(glBindVertexArray(ppFullQuadArray));
+    graph.compile();
+    graph.execute();
+    if (opts->postProcessingOptions & BLOOM) {
+        bloomTimer.frameEnd();
+    }
 
-            // Bind the framebuffer textures
-            GL_CHECK(glActiveTexture(GL_TEXTURE0));
-            GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboPTextureOutput));
+    if (checkpointWriter != nullptr) {
+        finishCheckpoint(false);
+        if (clock->elapsedTime - lastCheckpointTime >= CHECKPOINT_INTERVAL) {
+            startCheckpoint();
+            lastCheckpointTime = clock->elapsedTime;
+        }
+    }
 
-            GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    if (swap) {
+        clock->resetFrameSwapTime();
+    }
+    governFrame();
+}
 
-            _swapPPBuffersPM();
+void renderer::governFrame() {
+    if (replayer != nullptr) {
+        if (replayer->frame().quality != qualityIndex) {
+            qualityIndex = replayer->frame().quality;
+            applyQuality(QualityGovernor::ladderLevel(qualityIndex));
         }
+    } else if (governor != nullptr && governor->frameEnd()) {
+        qualityIndex = governor->levelIndex();
+        applyQuality(governor->level());
     }
-    if (opts->postProcessingOptions & BLUR) {
-        _sampleFrameBuffersForPostProcessing();
-        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, fboM));
-        clear();
-        ppBlurProgram->useProgram();
 
-        GL_CHECK(glUniform1i(ppBlurProgram->getUniformLocation("u_textureC"), 0));
-        GL_CHECK(glUniform1f(ppBlurProgram->getUniformLocation("u_blurSize"), opts->blurSize));
-        GL_CHECK(glBindVertexArray(ppFullQuadArray));
-
-        // Bind the framebuffer textures
-        GL_CHECK(glActiveTexture(GL_TEXTURE0));
-        GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboCTextureOutput));
+    if (recorder != nullptr) {
+        eventLogFrame frame;
+        frame.deltaTime = clock->deltaTime;
+        frame.swapped = clock->frameSwapDeltaTime >= opts->swapTime;
+        frame.mouseX = events->mouseX;
+        frame.mouseY = events->mouseY;
+        frame.keysPressed = events->keysPressed;
+        frame.mouseLeft = events->mouseLeft;
+        frame.mouseRight = events->mouseRight;
+        frame.mouseMiddle = events->mouseMiddle;
+        frame.quality = qualityIndex;
+        recorder->write(frame);
+    }
+}
 
-        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+void renderer::applyQuality(const qualityLevel &level) {
+#ifndef __ANDROID__
+    const bool samplesChanged = !opts->distanceFieldGlyphs && level.antialiasSamples != quality.antialiasSamples;
+    if (samplesChanged || level.resolutionScale != quality.resolutionScale) {
+        // The ghosting history is lost with the old framebuffers, it builds up again within a second
+        quality = level;
+        destroyFrameBuffers();
+        antialiasSamples = opts->distanceFieldGlyphs ? 0 : level.antialiasSamples;
+        makeFrameBuffers();
+        return;
+    }
+#endif
+    quality = level;
+}
 
-        _swapPPBuffersCM();
+void renderer::restoreCheckpoint() const {
+    // The clock carries on where it stopped, so glyphs and trail stamps line up with the restored state
+    if (const auto *elapsedTime = static_cast<const double *>(checkpoint->section(checkpointTag("CLCK"), sizeof(double)))) {
+        clock->elapsedTime = *elapsedTime;
     }
-    _resolveMultisampledFramebuffer(fboC, fboCOutput);
-    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-    clear(); // This is correct btw
+#ifndef __ANDROID__
+    // Draw the last presented frame into the scene that seeds the ghosting history, scaled if the resolution changed since
+    const auto *size = static_cast<const int32_t *>(checkpoint->section(checkpointTag("GHSZ"), 2 * sizeof(int32_t)));
+    if (size == nullptr) {
+        return;
+    }
+    const void *pixels = checkpoint->section(checkpointTag("GHST"), static_cast<size_t>(size[0]) * size[1] * 4);
+    if (pixels == nullptr) {
+        return;
+    }
+
+    GLuint texture;
+    GL_CHECK(glGenTextures(1, &texture));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture));
+    GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size[0], size[1], 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo));
+    GL_CHECK(glViewport(0, 0, renderWidth, renderHeight));
+    GL_CHECK(glDisable(GL_BLEND));
     ppFinalProgram->useProgram();
+    GL_CHECK(glUniform1i(ppFinalProgram->getUniformLocation("u_texture"), 0));
     GL_CHECK(glBindVertexArray(ppFullQuadArray));
+    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    GL_CHECK(glEnable(GL_BLEND));
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    GL_CHECK(glDeleteTextures(1, &texture));
+#endif
+}
 
-    GL_CHECK(glUniform1i(ppFinalProgram->getUniformLocation("u_texture"), 0));
+void renderer::addCheckpointSections() const {
+    *static_cast<double *>(checkpointWriter->add(checkpointTag("CLCK"), sizeof(double))) = clock->elapsedTime;
+    app->saveCheckpoint(*checkpointWriter);
+}
 
-    GL_CHECK(glActiveTexture(GL_TEXTURE0));
-    GL_CHECK(glBindTexture(GL_TEXTURE_2D, fboCTextureOutput));
-    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+#ifndef __ANDROID__
+const renderTarget *renderer::checkpointHistory() {
+    // Accumulated ghosting keeps the history in the scene, which has to be resolved first. A multisampled blit
+    // can't change the format, reading back converts a half float scene
+    if (opts->postProcessingOptions & GHOSTING && opts->accumulateGhosting) {
+        if (checkpointResolve.fbo == 0) {
+            createRenderTarget(checkpointResolve, {1, scene.desc.format, false}, renderWidth, renderHeight);
+        }
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, scene.fbo));
+        GL_CHECK(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, checkpointResolve.fbo));
+        GL_CHECK(glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST));
+        return &checkpointResolve;
+    }
+    // Otherwise the last frame that was presented and kept
+    return graph.findHistory(ghostingHistory);
+}
+#endif
 
-    // Swap the framebuffers
-    if (clock->frameSwapDeltaTime >= opts->swapTime) {
-        GLuint temp = fboPTexture;
-        fboPTexture = fboCTexture;
-        fboCTexture = temp;
+void renderer::saveCheckpoint() {
+    // A periodic checkpoint still in flight goes out first, the writer holds one checkpoint at a time
+    finishCheckpoint(true);
+    addCheckpointSections();
+#ifndef __ANDROID__
+    if (const renderTarget *history = checkpointHistory(); history != nullptr) {
+        const int32_t size[2] = {static_cast<int32_t>(history->width), static_cast<int32_t>(history->height)};
+        checkpointWriter->add(checkpointTag("GHSZ"), size, sizeof(size));
+        void *pixels = checkpointWriter->add(checkpointTag("GHST"), static_cast<size_t>(size[0]) * size[1] * 4);
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, history->fbo));
+        GL_CHECK(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+        GL_CHECK(glReadPixels(0, 0, size[0], size[1], GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+    }
+#endif
+    checkpointWriter->commit(opts->checkpointPath.value());
+}
 
-        temp = fboP;
-        fboP = fboC;
-        fboC = temp;
+void renderer::startCheckpoint() {
+    // Still waiting on the last one
+    if (checkpointFence != nullptr) {
+        return;
+    }
+    // The state is taken now, what lives on the GPU is copied into buffers the fence below guards
+    *static_cast<double *>(checkpointWriter->add(checkpointTag("CLCK"), sizeof(double))) = clock->elapsedTime;
+    app->startCheckpoint(*checkpointWriter);
+#ifndef __ANDROID__
+    checkpointSize[0] = 0;
+    checkpointSize[1] = 0;
+    if (const renderTarget *history = checkpointHistory(); history != nullptr) {
+        checkpointSize[0] = static_cast<int32_t>(history->width);
+        checkpointSize[1] = static_cast<int32_t>(history->height);
+        if (checkpointPixelBuffer == 0) {
+            GL_CHECK(glGenBuffers(1, &checkpointPixelBuffer));
+        }
+        GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, checkpointPixelBuffer));
+        GL_CHECK(glBufferData(GL_PIXEL_PACK_BUFFER,
+            static_cast<GLsizeiptr>(checkpointSize[0]) * checkpointSize[1] * 4, nullptr, GL_STREAM_READ));
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, history->fbo));
+        GL_CHECK(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+        GL_CHECK(glReadPixels(0, 0, checkpointSize[0], checkpointSize[1], GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+        GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+        GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    }
+#endif
+    GL_CHECK(checkpointFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
 
-        temp = fboPTextureOutput;
-        fboPTextureOutput = fboCTextureOutput;
-        fboCTextureOutput = temp;
+void renderer::finishCheckpoint(const bool wait) {
+    if (checkpointFence == nullptr) {
+        return;
+    }
+    // Polled every frame until the copies are done, mapping the buffers after that doesn't stall
+    if (!wait) {
+        GLenum result;
+        GL_CHECK(result = glClientWaitSync(checkpointFence, 0, 0));
+        if (result == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+    }
+    GL_CHECK(glDeleteSync(checkpointFence));
+    checkpointFence = nullptr;
 
-        temp = fboPOutput;
-        fboPOutput = fboCOutput;
-        fboCOutput = temp;
-        clock->resetFrameSwapTime();
+#ifndef __ANDROID__
+    if (checkpointSize[0] > 0) {
+        const size_t size = static_cast<size_t>(checkpointSize[0]) * checkpointSize[1] * 4;
+        checkpointWriter->add(checkpointTag("GHSZ"), checkpointSize, sizeof(checkpointSize));
+        void *pixels = checkpointWriter->add(checkpointTag("GHST"), size);
+        const void *mapped;
+        GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, checkpointPixelBuffer));
+        GL_CHECK(mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT));
+        if (mapped != nullptr) {
+            memcpy(pixels, mapped, size);
+            GL_CHECK(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+        }
+        GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
     }
+#endif
+    app->finishCheckpoint(*checkpointWriter);
+    checkpointWriter->commit(opts->checkpointPath.value());
 }
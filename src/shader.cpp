@@ -109,12 +109,24 @@ void ShaderProgram::uniformBlockBinding(const GLuint blockIndex, const GLuint bl
     GL_CHECK(glUniformBlockBinding(program, blockIndex, blockBinding));
 }
 
+void ShaderProgram::transformFeedbackVaryings(const GLchar *const *varyings, const GLsizei count) const {
+    GL_CHECK(glTransformFeedbackVaryings(program, count, varyings, GL_INTERLEAVED_ATTRIBS));
+}
+
 void ShaderProgram::loadShader(const unsigned char *source, const int length, const GLuint type) {
     const std::string src(reinterpret_cast<const char *>(source), length);
     const std::string convertedSrc = convertShaderForES(src);
     return loadShader(convertedSrc.c_str(), type);
 }
 
+void ShaderProgram::loadShader(const unsigned char *source, const int length, const GLuint type,
+                               const std::string &defines) {
+    std::string src(reinterpret_cast<const char *>(source), length);
+    const size_t versionEnd = src.find('\n');
+    src.insert(versionEnd == std::string::npos ? src.size() : versionEnd + 1, defines);
+    return loadShader(src.c_str(), type);
+}
+
 void ShaderProgram::loadShader(const char *source, const GLuint type) {
     // Convert shader for OpenGL ES if needed
     const std::string convertedSource = convertShaderForES(std::string(source));
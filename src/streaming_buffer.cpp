@@ -0,0 +1,91 @@
+#include "streaming_buffer.h"
+#include <gl_errors.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+void StreamingBuffer::create(const GLenum target, const GLsizeiptr segmentSize, const int segments) {
+    this->target = target;
+    this->segmentSize = (segmentSize + STREAMING_BUFFER_ALIGNMENT - 1) / STREAMING_BUFFER_ALIGNMENT * STREAMING_BUFFER_ALIGNMENT;
+    fences.assign(segments, nullptr);
+    // The first map moves on to segment 0
+    segment = segments - 1;
+
+    const GLsizeiptr size = this->segmentSize * segments;
+    GL_CHECK(glGenBuffers(1, &handle));
+    GL_CHECK(glBindBuffer(target, handle));
+#ifndef __ANDROID__
+    if (GLAD_GL_ARB_buffer_storage) {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GL_CHECK(glBufferStorage(target, size, nullptr, flags));
+        GL_CHECK(mapped = static_cast<unsigned char *>(glMapBufferRange(target, 0, size, flags)));
+        return;
+    }
+#endif
+    GL_CHECK(glBufferData(target, size, nullptr, GL_STREAM_DRAW));
+}
+
+void StreamingBuffer::destroy() {
+    for (GLsync &sync : fences) {
+        if (sync != nullptr) {
+            GL_CHECK(glDeleteSync(sync));
+            sync = nullptr;
+        }
+    }
+    if (mapped != nullptr) {
+        GL_CHECK(glBindBuffer(target, handle));
+        GL_CHECK(glUnmapBuffer(target));
+        mapped = nullptr;
+    }
+    GL_CHECK(glDeleteBuffers(1, &handle));
+    handle = 0;
+}
+
+void *StreamingBuffer::map() {
+    segment = (segment + 1) % static_cast<int>(fences.size());
+
+    // Only blocks when the GPU is still reading this segment from STREAMING_BUFFER_SEGMENTS frames ago
+    stallTime = 0.0;
+    if (GLsync &sync = fences[segment]; sync != nullptr) {
+        const auto start = std::chrono::steady_clock::now();
+        GLenum result;
+        do {
+            GL_CHECK(result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000));
+        } while (result == GL_TIMEOUT_EXPIRED);
+        stallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        totalStallTime += stallTime;
+        GL_CHECK(glDeleteSync(sync));
+        sync = nullptr;
+    }
+
+    const GLintptr offset = segmentSize * segment;
+    if (mapped != nullptr) {
+        return mapped + offset;
+    }
+
+    void *pointer;
+    GL_CHECK(glBindBuffer(target, handle));
+    GL_CHECK(pointer = glMapBufferRange(target, offset, segmentSize,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    if (pointer == nullptr) {
+        std::cerr << "Failed to map streaming buffer" << std::endl;
+        exit(1);
+    }
+    return pointer;
+}
+
+GLintptr StreamingBuffer::unmap() {
+    if (mapped == nullptr) {
+        GL_CHECK(glBindBuffer(target, handle));
+        GL_CHECK(glUnmapBuffer(target));
+    }
+    return segmentSize * segment;
+}
+
+void StreamingBuffer::fence() {
+    // A segment drawn again on a later frame only needs the newest fence
+    if (fences[segment] != nullptr) {
+        GL_CHECK(glDeleteSync(fences[segment]));
+    }
+    GL_CHECK(fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
@@ -0,0 +1,67 @@
+// Packs raindrops the way --compact-instances uploads them, decodes them the way matrix.vert does and compares the
+// result with the float instances. Run by ctest, fails when a decoded value is off by more than its threshold:
+// - positions by half a fraction step, 1/2048 pixel, which moves an antialiased glyph edge by less than one level
+// - velocities by half a velocity step, 1/32 pixel
+// - the color offset by half an 8-bit step of the hue, at most 3 levels in any channel of the rainbow
+#include "apps/matrix_rain.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static float decodePosition(const int16_t whole, const uint8_t fraction) {
+    return (static_cast<float>(whole) + static_cast<float>(fraction) / 256.0f) / MATRIX_RAIN_FIXED_SCALE;
+}
+
+static float hueDistance(const float a, const float b) {
+    const float difference = std::fabs(a - std::floor(a) - (b - std::floor(b)));
+    return std::min(difference, 1.0f - difference);
+}
+
+int main() {
+    constexpr int count = 1 << 16;
+    // An 8K screen with raindrops above, below and beside it, colors wider than MATRIX_COLOR_VARIATION for particles
+    std::vector<RainDrawData> instances(count);
+    std::vector<float> velocityX(count), velocityY(count);
+    uint32_t state = 0x9e3779b9u;
+    const auto next = [&state](const float a, const float b) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return a + (b - a) * static_cast<float>(state >> 8) / static_cast<float>(1 << 24);
+    };
+    for (int i = 0; i < count; ++i) {
+        instances[i] = {next(-256.0f, 7936.0f), next(-256.0f, 4576.0f), next(-2.0f, 2.0f), i % 6};
+        velocityX[i] = next(-300.0f, 300.0f);
+        velocityY[i] = next(-300.0f, 300.0f);
+    }
+    const RainOutput out = {instances.data(), velocityX.data(), velocityY.data()};
+    std::vector<RainCompactData> packed(count);
+    std::vector<int16_t> packedVelocityX(count), packedVelocityY(count);
+    packRainOutput(out, 0, count, packed.data(), packedVelocityX.data(), packedVelocityY.data());
+
+    const float positionLimit = 0.5f / (MATRIX_RAIN_FIXED_SCALE * MATRIX_RAIN_FIXED_FRACTION) + 1e-3f / MATRIX_RAIN_FIXED_SCALE;
+    const float velocityLimit = 0.5f / MATRIX_RAIN_VELOCITY_SCALE + 1e-4f;
+    const float colorLimit = 0.5f / 255.0f + 1e-6f;
+    float positionError = 0.0f, velocityError = 0.0f, colorError = 0.0f;
+    int sparkErrors = 0;
+    for (int i = 0; i < count; ++i) {
+        const RainCompactData &p = packed[i];
+        positionError = std::max({positionError,
+            std::fabs(decodePosition(p.x, p.fractionX) - instances[i].x),
+            std::fabs(decodePosition(p.y, p.fractionY) - instances[i].y)});
+        velocityError = std::max({velocityError,
+            std::fabs(static_cast<float>(packedVelocityX[i]) / MATRIX_RAIN_VELOCITY_SCALE - velocityX[i]),
+            std::fabs(static_cast<float>(packedVelocityY[i]) / MATRIX_RAIN_VELOCITY_SCALE - velocityY[i])});
+        colorError = std::max(colorError, hueDistance(static_cast<float>(p.colorOffset) / 255.0f, instances[i].colorOffset));
+        sparkErrors += p.spark != instances[i].spark;
+    }
+
+    std::printf("position error %g px (limit %g), velocity error %g px (limit %g), color error %g (limit %g)\n",
+        positionError, positionLimit, velocityError, velocityLimit, colorError, colorLimit);
+    if (positionError > positionLimit || velocityError > velocityLimit || colorError > colorLimit || sparkErrors > 0) {
+        std::printf("compact instances decode too far from the float ones, %d sparks differ\n", sparkErrors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Rasterizes a TrueType font into the atlas the matrix app embeds: assets/fonts/<name>.raw with one coverage
+// byte per texel and assets/fonts/include/<name>_info.h with where every glyph is
+#include "font_atlas_builder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define DEFAULT_FONT "assets/fonts/JiyunoTsubasa.ttf"
+#define DEFAULT_NAME "matrix_font"
+#define DEFAULT_INFO "matrixFontInfo"
+#define DEFAULT_OUTPUT "assets/fonts"
+
+static const char *usage =
+    "usage: font_atlas_maker [options]\n"
+    "    --font: the TrueType font, default " DEFAULT_FONT "\n"
+    "    --characters: the characters in glyph index order, UTF-8\n"
+    "    --sizes: comma separated pixels per em, default 100, more than one size names every atlas after its size\n"
+    "    --padding: empty texels around every glyph, default 2, use FONT_DISTANCE_FIELD_SPREAD for --sdf\n"
+    "    --cells: keep every glyph in a cell as wide as its advance on a shared baseline instead of trimming it\n"
+    "    --name: the file name of the atlas, default " DEFAULT_NAME "\n"
+    "    --info: the name of its FontInfo, default " DEFAULT_INFO "\n"
+    "    --output: the directory to write to, default " DEFAULT_OUTPUT;
+
+static void writeHeader(const std::string &path, const std::string &name, const std::string &info,
+                        const builtFontAtlas &atlas) {
+    std::string guard;
+    for (const char c : name) {
+        guard += static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    }
+    guard += "_INFO_H";
+    const std::string list = info + "CharacterList";
+
+    std::ofstream file(path);
+    file << "#ifndef " << guard << "\n#define " << guard << "\n#include \"fonts.h\"\n\n";
+    file << "constexpr CharacterInfo " << list << "[] = {\n";
+    for (size_t i = 0; i < atlas.characters.size(); ++i) {
+        const CharacterInfo &character = atlas.characters[i];
+        file << "    {" << character.xOffset << "," << character.yOffset << "," << character.width << ","
+             << character.height << "}" << (i + 1 < atlas.characters.size() ? ",\n" : "\n");
+    }
+    file << "};\n\n";
+    file << "static constexpr FontInfo " << info << " = {\n"
+         << "    .width = " << atlas.width << ",\n"
+         << "    .height = " << atlas.height << ",\n"
+         << "    .size = " << atlas.size << ",\n"
+         << "    .characterCount = " << atlas.characters.size() << ",\n"
+         << "    .characterInfoList = " << list << "\n"
+         << "};\n\n";
+    file << "#endif //" << guard << "\n";
+    if (!file) {
+        std::cerr << "Couldn't write " << path << std::endl;
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string fontPath = DEFAULT_FONT;
+    std::string characters = FONT_ATLAS_DEFAULT_CHARACTERS;
+    std::vector<int> sizes;
+    int padding = FONT_ATLAS_DEFAULT_PADDING;
+    bool trim = true;
+    std::string name = DEFAULT_NAME;
+    std::string info = DEFAULT_INFO;
+    std::string output = DEFAULT_OUTPUT;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << usage << std::endl;
+            return 0;
+        } else if (arg.find("--font=") == 0) {
+            fontPath = arg.substr(7);
+        } else if (arg.find("--characters=") == 0) {
+            characters = arg.substr(13);
+        } else if (arg.find("--sizes=") == 0) {
+            std::stringstream list(arg.substr(8));
+            std::string size;
+            while (std::getline(list, size, ',')) {
+                sizes.push_back(static_cast<int>(strtol(size.c_str(), nullptr, 10)));
+            }
+        } else if (arg.find("--padding=") == 0) {
+            padding = std::max(0, static_cast<int>(strtol(argv[i] + 10, nullptr, 10)));
+        } else if (arg == "--cells") {
+            trim = false;
+        } else if (arg.find("--name=") == 0) {
+            name = arg.substr(7);
+        } else if (arg.find("--info=") == 0) {
+            info = arg.substr(7);
+        } else if (arg.find("--output=") == 0) {
+            output = arg.substr(9);
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl << usage << std::endl;
+            exit(1);
+        }
+    }
+    if (sizes.empty()) {
+        sizes.push_back(100);
+    }
+
+    std::ifstream fontFile(fontPath, std::ios::binary);
+    if (!fontFile) {
+        std::cerr << "Couldn't open " << fontPath << std::endl;
+        exit(1);
+    }
+    const std::vector<unsigned char> font{std::istreambuf_iterator<char>(fontFile), std::istreambuf_iterator<char>()};
+    const std::vector<uint32_t> codepoints = decodeUtf8(characters);
+
+    for (const int size : sizes) {
+        if (size <= 0) {
+            std::cerr << "Invalid size: " << size << std::endl;
+            exit(1);
+        }
+        builtFontAtlas atlas;
+        if (!buildFontAtlas(font, codepoints, size, padding, trim, atlas)) {
+            exit(1);
+        }
+        const std::string suffix = sizes.size() > 1 ? "_" + std::to_string(size) : "";
+        const std::string atlasName = name + suffix;
+        const std::string atlasInfo = info + (sizes.size() > 1 ? std::to_string(size) : "");
+
+        const std::string rawPath = output + "/" + atlasName + ".raw";
+        std::ofstream raw(rawPath, std::ios::binary);
+        raw.write(reinterpret_cast<const char *>(atlas.pixels.data()), static_cast<std::streamsize>(atlas.pixels.size()));
+        if (!raw) {
+            std::cerr << "Couldn't write " << rawPath << std::endl;
+            exit(1);
+        }
+        writeHeader(output + "/include/" + atlasName + "_info.h", atlasName, atlasInfo, atlas);
+        std::cout << atlasName << ": " << codepoints.size() << " glyphs at " << size << " px in " << atlas.width
+                  << "x" << atlas.height << std::endl;
+    }
+    return 0;
+}